@@ -0,0 +1,97 @@
+/*
+ * Host benchmark for the batch ball physics (balls.c).
+ *
+ * Rolls a large batch of balls around a course with scattered walls,
+ * water and a hole, relaunching any ball that stops, and reports the
+ * sustained rate in ball-steps per millisecond.
+ *
+ *     make bench
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "balls.h"
+
+#define WIDTH 640
+#define HEIGHT 512
+#define RADIUS 5
+#define NUM_BALLS 10000
+#define NUM_WALLS 16
+#define NUM_STEPS 500
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Send ball i off from a random open spot at a random shot speed */
+static void relaunch(ball_batch_t *batch, int i, const material_map_t *terrain) {
+    int x, y;
+    do {
+        x = RADIUS + rand() % (WIDTH - 2 * RADIUS);
+        y = RADIUS + rand() % (HEIGHT - 2 * RADIUS);
+    } while (mm_at(terrain, x, y) != MAT_GRASS);
+    balls_place(batch, i, fix_from_int(x), fix_from_int(y));
+    fix_t speed = 6 * FIX_ONE * (1 + rand() % 5);
+    int angle = rand() % FIX_ANGLE_STEPS;
+    balls_launch(batch, i, fix_mul(speed, fix_cos(angle)), fix_mul(speed, fix_sin(angle)));
+}
+
+int main(void) {
+    srand(107);
+    bp_rect_t walls[NUM_WALLS];
+    material_map_t terrain = { 0 };
+    broadphase_t grid = { 0 };
+    if (!mm_init(&terrain, WIDTH, HEIGHT, 2)) {
+        return 1;
+    }
+    for (int i = 0; i < NUM_WALLS; i++) {
+        bool tall = rand() % 2;
+        walls[i] = (bp_rect_t){ rand() % (WIDTH - 60), rand() % (HEIGHT - 60),
+                                tall ? 12 : 60, tall ? 60 : 12 };
+        mm_fill_rect(&terrain, walls[i].x, walls[i].y, walls[i].width, walls[i].height, MAT_WALL);
+    }
+    for (int i = 0; i < 3; i++) {
+        mm_fill_rect(&terrain, rand() % (WIDTH - 30), rand() % (HEIGHT - 30), 30, 30, MAT_WATER);
+    }
+    mm_fill_circle(&terrain, WIDTH / 2, HEIGHT / 2, 10, MAT_HOLE);
+    mm_finish(&terrain);
+    if (!bp_build(&grid, WIDTH, HEIGHT, 5, walls, NUM_WALLS)) {
+        return 1;
+    }
+    course_t course = { WIDTH, HEIGHT, RADIUS, FIX_ONE / 5, walls, NUM_WALLS, &grid, &terrain };
+
+    ball_batch_t batch = { 0 };
+    if (!balls_init(&batch, NUM_BALLS)) {
+        return 1;
+    }
+    for (int i = 0; i < NUM_BALLS; i++) {
+        balls_add(&batch, 0, 0);
+        relaunch(&batch, i, &terrain);
+    }
+
+    long long ball_steps = 0;
+    double elapsed = 0;
+    for (int step = 0; step < NUM_STEPS; step++) {
+        for (int i = 0; i < NUM_BALLS; i++) {
+            if (batch.state[i] != BALL_ROLLING) {
+                relaunch(&batch, i, &terrain);
+            }
+        }
+        double start = now_ms();
+        balls_step(&batch, &course);
+        elapsed += now_ms() - start;
+        ball_steps += NUM_BALLS;
+    }
+    printf("%lld ball-steps in %.1f ms: %.0f ball-steps/ms\n", ball_steps, elapsed, ball_steps / elapsed);
+
+    balls_free(&batch);
+    bp_free(&grid);
+    mm_free(&terrain);
+    return 0;
+}
@@ -0,0 +1,5 @@
+/*
+ * Host stand-in for the CS107E strings.h, so that modules written for the
+ * Pi can be compiled natively (see the `host` targets in the Makefile).
+ */
+#include <string.h>
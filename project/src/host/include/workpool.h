@@ -0,0 +1,39 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+/*
+ * Work-stealing thread pool for the host tools.
+ *
+ * Tasks are numbered 0 .. num_tasks - 1 and dealt out to the threads as
+ * contiguous ranges. A thread works through its range from the front;
+ * one that runs dry steals the back half of another thread's range, so
+ * uneven tasks still keep every core busy until the end.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+/*
+ * Type: 'pool_task_fn_t'
+ *
+ * Runs task number `task` on thread number `thread` (0 .. num_threads - 1),
+ * e.g. to pick that thread's scratch space.
+ */
+typedef void (*pool_task_fn_t)(int task, int thread, void *aux);
+
+/*
+ * 'pool_run'
+ *
+ * Run every task on `num_threads` threads and return once all are done.
+ * Returns 0, or -1 if out of memory (nothing ran). If some threads
+ * cannot be started, the others take over their tasks.
+ */
+int pool_run(int num_tasks, int num_threads, pool_task_fn_t fn, void *aux);
+
+/*
+ * 'pool_cpu_count'
+ *
+ * Number of cores available to run threads on, at least 1.
+ */
+int pool_cpu_count(void);
+
+#endif
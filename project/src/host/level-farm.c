@@ -0,0 +1,206 @@
+/*
+ * Host level farm: pre-generates the library of levels linked into the
+ * Pi image, so the game does not lay out and check levels at round start.
+ *
+ * Candidate levels are made from seeds with the game's own generator
+ * (levelgen.c), spread over every core with the work-stealing pool.
+ * Each one that the reach check passes is solved from the tee (see
+ * solver.h) and given a difficulty from where its shots end up: par
+ * first, then the share of shots that miss the hole and the share that
+ * find the water. The hardest are kept and written, easiest first, as
+ * a level pack (see level.h).
+ *
+ * Every candidate depends only on its seed, and the seeds only on the
+ * farm's seed, so the same arguments always write the same pack, on
+ * any number of threads.
+ *
+ *     make farm
+ *     build/host/level-farm out.lvl [candidates] [keep] [seed] [threads]
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "levelgen.h"
+#include "solver.h"
+#include "workpool.h"
+
+#define PERTURBATIONS 1
+#define MAX_STEPS 300
+#define CHUNK 64        // candidate shots per solver_eval call
+
+/* One candidate level: its seed, then what the farm found */
+typedef struct {
+    unsigned int seed;
+    int difficulty;     // -1 if the level was rejected
+} candidate_t;
+
+/* Per-thread scratch: generator, course and solver */
+typedef struct {
+    uint32_t record[LEVEL_BYTES(LEVEL_MAX_SHAPES) / 4];
+    levelgen_t gen;
+    level_course_t field;
+    solver_worker_t worker;
+    int scores[SOLVER_CANDIDATES];
+} thread_state_t;
+
+typedef struct {
+    candidate_t *candidates;
+    int num_candidates;
+    thread_state_t *threads;
+    pthread_mutex_t lock;   // guards the progress report
+    int done;
+    double start_ms;
+} farm_t;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Difficulty from the par and from the scores of every shot from the tee */
+static int difficulty(int par, const int scores[]) {
+    int misses = 0, wet = 0;
+    for (int c = 0; c < SOLVER_CANDIDATES; c++) {
+        misses += scores[c] != 0;
+        wet += scores[c] >= SOLVER_WATER_PENALTY;
+    }
+    return 1000 * par + 500 * misses / SOLVER_CANDIDATES + 500 * wet / SOLVER_CANDIDATES;
+}
+
+/* Generate a candidate's level into the thread's record and score it */
+static int farm_level(thread_state_t *state, unsigned int seed) {
+    level_t *level = (level_t *)state->record;
+    levelgen_make(&state->gen, level, seed, &state->field);
+    if (level->par < 0 || !state->field.grid_ready || !state->field.terrain_ready) {
+        return -1;   // goal not reachable in five shots, or not checked
+    }
+    solver_problem_t problem = {
+        .course = &state->field.course,
+        .tee_x = fix_from_int(level->tee_x),
+        .tee_y = fix_from_int(level->tee_y),
+        .goal = { level->goal.x, level->goal.y, level->goal.width, level->goal.height },
+        .shot_speed = LEVELGEN_SHOT_SPEED,
+        .perturbations = PERTURBATIONS,
+        .seed = seed,
+        .max_steps = MAX_STEPS,
+    };
+    for (int first = 0; first < SOLVER_CANDIDATES; first += CHUNK) {
+        solver_eval(&problem, &state->worker, first, CHUNK, state->scores);
+    }
+    return difficulty(level->par, state->scores);
+}
+
+static void farm_task(int task, int thread, void *aux) {
+    farm_t *farm = aux;
+    candidate_t *candidate = &farm->candidates[task];
+    candidate->difficulty = farm_level(&farm->threads[thread], candidate->seed);
+
+    pthread_mutex_lock(&farm->lock);
+    farm->done++;
+    if (farm->done % 64 == 0 || farm->done == farm->num_candidates) {
+        double elapsed = (now_ms() - farm->start_ms) / 1e3;
+        fprintf(stderr, "\r%d/%d levels, %.0f s, about %.0f s left", farm->done, farm->num_candidates,
+                elapsed, elapsed * (farm->num_candidates - farm->done) / farm->done);
+        fflush(stderr);
+    }
+    pthread_mutex_unlock(&farm->lock);
+}
+
+/* Hardest first; equal difficulties keep the order of their seeds */
+static int by_difficulty(const void *a, const void *b) {
+    const candidate_t *x = a, *y = b;
+    if (x->difficulty != y->difficulty) {
+        return x->difficulty < y->difficulty ? 1 : -1;
+    }
+    return x->seed < y->seed ? -1 : x->seed > y->seed;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : NULL;
+    int num_candidates = argc > 2 ? atoi(argv[2]) : 4096;
+    int keep = argc > 3 ? atoi(argv[3]) : 64;
+    unsigned int seed = argc > 4 ? strtoul(argv[4], NULL, 10) : 107;
+    int cores = argc > 5 ? atoi(argv[5]) : pool_cpu_count();
+
+    farm_t farm = { .num_candidates = num_candidates };
+    farm.candidates = calloc(num_candidates, sizeof(candidate_t));
+    farm.threads = calloc(cores, sizeof(thread_state_t));
+    if (path == NULL || num_candidates < 1 || keep < 1 || cores < 1 || farm.candidates == NULL || farm.threads == NULL) {
+        fprintf(stderr, "usage: %s out.lvl [candidates] [keep] [seed] [threads]\n", argv[0]);
+        return 1;
+    }
+    rng_t seeds;
+    rng_seed(&seeds, seed);
+    for (int i = 0; i < num_candidates; i++) {
+        farm.candidates[i].seed = rng_next(&seeds);
+    }
+    solver_problem_t shape = { .perturbations = PERTURBATIONS };
+    for (int t = 0; t < cores; t++) {
+        farm.threads[t].gen.budget = LEVELGEN_EXHAUSTIVE;   // no round to hold up here
+        if (!solver_worker_init(&farm.threads[t].worker, &shape, CHUNK)) {
+            return 1;
+        }
+    }
+
+    pthread_mutex_init(&farm.lock, NULL);
+    farm.start_ms = now_ms();
+    if (pool_run(num_candidates, cores, farm_task, &farm) < 0) {
+        return 1;
+    }
+    fprintf(stderr, "\n");
+    pthread_mutex_destroy(&farm.lock);
+
+    qsort(farm.candidates, num_candidates, sizeof(candidate_t), by_difficulty);
+    int kept = 0;
+    while (kept < keep && kept < num_candidates && farm.candidates[kept].difficulty >= 0) {
+        kept++;
+    }
+
+    // regenerate the kept levels from their seeds and write them easiest first
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return 1;
+    }
+    thread_state_t *state = &farm.threads[0];
+    level_t *level = (level_t *)state->record;
+    int pars[LEVELGEN_MAX_SHOTS + 1] = { 0 };
+    for (int i = kept - 1; i >= 0; i--) {
+        memset(state->record, 0, sizeof(state->record));   // padding is written out too
+        levelgen_make(&state->gen, level, farm.candidates[i].seed, &state->field);
+        fwrite(level, level->size, 1, out);
+        pars[level->par]++;
+    }
+    if (fclose(out) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    int rejected = 0;
+    for (int i = 0; i < num_candidates; i++) {
+        rejected += farm.candidates[i].difficulty < 0;
+    }
+    printf("%s: kept %d of %d levels (%d rejected), difficulty %d .. %d, par",
+           path, kept, num_candidates, rejected,
+           kept > 0 ? farm.candidates[kept - 1].difficulty : 0, kept > 0 ? farm.candidates[0].difficulty : 0);
+    for (int par = 1; par <= LEVELGEN_MAX_SHOTS; par++) {
+        printf(" %d:%d", par, pars[par]);
+    }
+    printf(", %.1f s\n", (now_ms() - farm.start_ms) / 1e3);
+
+    for (int t = 0; t < cores; t++) {
+        solver_worker_free(&farm.threads[t].worker);
+        level_course_free(&farm.threads[t].field);
+        levelgen_free(&farm.threads[t].gen);
+    }
+    free(farm.threads);
+    free(farm.candidates);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Host tool that builds a binary level pack (see level.h) from a text
+ * description, so hand-built holes can be linked into the image.
+ *
+ *     build/host/level-pack levels.txt levels.lvl
+ *
+ * Every level starts with a `level` line; the lines after it describe
+ * that level until the next one. Coordinates are in pixels, and shapes
+ * are painted in the order given:
+ *
+ *     level <seed>                 seed it was generated from, 0 if none
+ *     tee <x> <y>
+ *     goal <x> <y> <w> <h>
+ *     par <shots>                  optional, unknown if left out
+ *     wall|water|grass <x> <y> <w> <h>
+ *
+ * Blank lines and anything after a '#' are ignored.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "level.h"
+
+static const struct {
+    const char *name;
+    material_t material;
+} MATERIALS[] = {
+    { "wall", MAT_WALL },
+    { "water", MAT_WATER },
+    { "grass", MAT_GRASS },
+};
+
+static uint32_t record[LEVEL_BYTES(LEVEL_MAX_SHAPES) / 4];
+
+static int fail(const char *path, int line, const char *message) {
+    fprintf(stderr, "%s:%d: %s\n", path, line, message);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s levels.txt levels.lvl\n", argv[0]);
+        return 1;
+    }
+    FILE *in = fopen(argv[1], "r");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    FILE *out = fopen(argv[2], "wb");
+    if (out == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    level_t *level = (level_t *)record;
+    bool open = false;
+    int count = 0;
+    char text[256];
+    for (int line = 1; fgets(text, sizeof(text), in) != NULL; line++) {
+        text[strcspn(text, "#\n")] = '\0';
+        char word[16];
+        int a[4];
+        int n = sscanf(text, "%15s %d %d %d %d", word, &a[0], &a[1], &a[2], &a[3]);
+        if (n <= 0) {
+            continue;
+        }
+        if (strcmp(word, "level") == 0 && n == 2) {
+            if (open) {
+                fwrite(level, level->size, 1, out);
+                count++;
+            }
+            memset(record, 0, sizeof(record));   // padding is written out too
+            level_init(level, a[0]);
+            open = true;
+            continue;
+        }
+        if (!open) {
+            return fail(argv[1], line, "expected 'level' first");
+        }
+        if (strcmp(word, "tee") == 0 && n == 3) {
+            level->tee_x = a[0];
+            level->tee_y = a[1];
+        } else if (strcmp(word, "goal") == 0 && n == 5) {
+            level->goal = (level_shape_t){ a[0], a[1], a[2], a[3], MAT_HOLE, 0 };
+        } else if (strcmp(word, "par") == 0 && n == 2) {
+            level->par = a[0];
+        } else {
+            int m = 0;
+            while (m < sizeof(MATERIALS) / sizeof(MATERIALS[0]) && strcmp(word, MATERIALS[m].name) != 0) {
+                m++;
+            }
+            if (m == sizeof(MATERIALS) / sizeof(MATERIALS[0]) || n != 5) {
+                return fail(argv[1], line, "unknown or malformed line");
+            }
+            if (!level_add(level, LEVEL_MAX_SHAPES, a[0], a[1], a[2], a[3], MATERIALS[m].material)) {
+                return fail(argv[1], line, "too many shapes");
+            }
+        }
+    }
+    if (open) {
+        fwrite(level, level->size, 1, out);
+        count++;
+    }
+    fclose(in);
+    if (fclose(out) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+    printf("%s: %d level(s)\n", argv[2], count);
+    return 0;
+}
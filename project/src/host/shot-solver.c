@@ -0,0 +1,145 @@
+/*
+ * Host driver for the shot solver (solver.c).
+ *
+ * Generates random levels as the game does (levelgen.h), then solves
+ * each one twice, once on a single thread and once spread over every
+ * core with the work-stealing pool, checks that both give the same
+ * scores, and reports the best shot and the time taken.
+ *
+ *     make solve
+ *     build/host/shot-solver [levels] [seed] [threads]
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "levelgen.h"
+#include "solver.h"
+#include "workpool.h"
+
+#define PERTURBATIONS 2
+#define MAX_STEPS 300
+#define TASK_CANDIDATES 16   // candidates per pool task
+
+/* Per-thread copies: the broadphase keeps per-query state */
+typedef struct {
+    level_course_t field;
+    solver_problem_t problem;
+    solver_worker_t worker;
+} thread_state_t;
+
+typedef struct {
+    thread_state_t *threads;
+    int *scores;
+} job_t;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Build the thread's own course for a level; the worker is kept from level to level */
+static bool thread_state_init(thread_state_t *state, const level_t *level) {
+    if (!level_course_build(&state->field, level)) {
+        return false;
+    }
+    state->problem = (solver_problem_t){
+        .course = &state->field.course,
+        .tee_x = fix_from_int(level->tee_x),
+        .tee_y = fix_from_int(level->tee_y),
+        .goal = { level->goal.x, level->goal.y, level->goal.width, level->goal.height },
+        .shot_speed = LEVELGEN_SHOT_SPEED,
+        .perturbations = PERTURBATIONS,
+        .seed = level->seed,
+        .max_steps = MAX_STEPS,
+    };
+    return state->worker.chunk != 0 || solver_worker_init(&state->worker, &state->problem, TASK_CANDIDATES);
+}
+
+static void thread_state_free(thread_state_t *state) {
+    solver_worker_free(&state->worker);
+    level_course_free(&state->field);
+}
+
+static void eval_task(int task, int thread, void *aux) {
+    job_t *job = aux;
+    thread_state_t *state = &job->threads[thread];
+    int first = task * TASK_CANDIDATES;
+    int count = SOLVER_CANDIDATES - first < TASK_CANDIDATES ? SOLVER_CANDIDATES - first : TASK_CANDIDATES;
+    solver_eval(&state->problem, &state->worker, first, count, job->scores);
+}
+
+/* Score every candidate on num_threads threads; returns the time taken in ms, or -1 */
+static double solve(int num_threads, thread_state_t *threads, int scores[]) {
+    job_t job = { threads, scores };
+    int tasks = (SOLVER_CANDIDATES + TASK_CANDIDATES - 1) / TASK_CANDIDATES;
+    double start = now_ms();
+    if (pool_run(tasks, num_threads, eval_task, &job) < 0) {
+        return -1;
+    }
+    return now_ms() - start;
+}
+
+int main(int argc, char *argv[]) {
+    int levels = argc > 1 ? atoi(argv[1]) : 4;
+    unsigned int seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 107;
+    int cores = argc > 3 ? atoi(argv[3]) : pool_cpu_count();
+
+    thread_state_t *threads = calloc(cores, sizeof(thread_state_t));
+    int *serial = malloc(SOLVER_CANDIDATES * sizeof(int));
+    int *parallel = malloc(SOLVER_CANDIDATES * sizeof(int));
+    if (cores < 1 || threads == NULL || serial == NULL || parallel == NULL) {
+        return 1;
+    }
+
+    static uint32_t record[LEVEL_BYTES(LEVEL_MAX_SHAPES) / 4];
+    level_t *level = (level_t *)record;
+    levelgen_t gen = { 0 };
+    level_course_t scratch = { 0 };   // levelgen_goal checks the goal on it
+    rng_t seeds;
+    rng_seed(&seeds, seed);
+
+    int status = 0;
+    for (int n = 0; n < levels && status == 0; n++) {
+        levelgen_make(&gen, level, rng_next(&seeds), &scratch);
+        for (int t = 0; t < cores; t++) {
+            if (!thread_state_init(&threads[t], level)) {
+                return 1;
+            }
+        }
+
+        double serial_ms = solve(1, threads, serial);
+        double parallel_ms = solve(cores, threads, parallel);
+        if (serial_ms < 0 || parallel_ms < 0) {
+            return 1;
+        }
+        int best = solver_best(serial, SOLVER_CANDIDATES);
+        int holes = 0;
+        for (int c = 0; c < SOLVER_CANDIDATES; c++) {
+            holes += serial[c] == 0;
+        }
+        printf("level %d (par %d): best rotor %d strength %d score %d, %d sure holes; "
+               "1 thread %.0f ms, %d threads %.0f ms\n",
+               n, level->par, solver_angle(best), solver_strength(best), serial[best], holes,
+               serial_ms, cores, parallel_ms);
+        if (memcmp(serial, parallel, SOLVER_CANDIDATES * sizeof(int)) != 0) {
+            printf("level %d: threaded scores differ from single-threaded ones\n", n);
+            status = 1;
+        }
+    }
+
+    for (int t = 0; t < cores; t++) {
+        thread_state_free(&threads[t]);
+    }
+    level_course_free(&scratch);
+    levelgen_free(&gen);
+    free(threads);
+    free(serial);
+    free(parallel);
+    return status;
+}
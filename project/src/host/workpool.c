@@ -0,0 +1,127 @@
+/*
+ * Work-stealing thread pool (see workpool.h).
+ *
+ * Each thread's work is the range [next, end) of task numbers, guarded
+ * by its own lock. Tasks never create more tasks, so a thread that
+ * finds every range empty is done.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "workpool.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    int next, end;
+} range_t;
+
+typedef struct pool pool_t;
+
+typedef struct {
+    pool_t *pool;
+    int id;
+    pthread_t thread;
+} worker_t;
+
+struct pool {
+    int num_threads;
+    range_t *ranges;
+    pool_task_fn_t fn;
+    void *aux;
+};
+
+/* Take the next task of a range, or -1 if it is empty */
+static int pop(range_t *range) {
+    int task = -1;
+    pthread_mutex_lock(&range->lock);
+    if (range->next < range->end) {
+        task = range->next++;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return task;
+}
+
+/* Move the back half of some other thread's range into thread t's; false if all are empty */
+static bool steal(pool_t *pool, int t) {
+    for (int k = 1; k < pool->num_threads; k++) {
+        range_t *victim = &pool->ranges[(t + k) % pool->num_threads];
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->end - victim->next;
+        if (left > 0) {
+            int first = victim->end - (left + 1) / 2;
+            int end = victim->end;
+            victim->end = first;
+            pthread_mutex_unlock(&victim->lock);
+
+            range_t *own = &pool->ranges[t];
+            pthread_mutex_lock(&own->lock);
+            own->next = first;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return false;
+}
+
+static void *work(void *arg) {
+    worker_t *worker = arg;
+    pool_t *pool = worker->pool;
+    do {
+        int task;
+        while ((task = pop(&pool->ranges[worker->id])) >= 0) {
+            pool->fn(task, worker->id, pool->aux);
+        }
+    } while (steal(pool, worker->id));
+    return NULL;
+}
+
+int pool_run(int num_tasks, int num_threads, pool_task_fn_t fn, void *aux) {
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    pool_t pool = { num_threads, calloc(num_threads, sizeof(range_t)), fn, aux };
+    worker_t *workers = calloc(num_threads, sizeof(worker_t));
+    if (pool.ranges == NULL || workers == NULL) {
+        free(pool.ranges);
+        free(workers);
+        return -1;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_mutex_init(&pool.ranges[t].lock, NULL);
+        pool.ranges[t].next = (long long)num_tasks * t / num_threads;
+        pool.ranges[t].end = (long long)num_tasks * (t + 1) / num_threads;
+        workers[t] = (worker_t){ &pool, t };
+    }
+
+    // thread 0 is the caller; if a thread fails to start, the others steal its work
+    int started = 1;
+    for (int t = 1; t < num_threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, work, &workers[t]) != 0) {
+            break;
+        }
+        started++;
+    }
+    work(&workers[0]);
+    for (int t = 1; t < started; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+
+    for (int t = 0; t < num_threads; t++) {
+        pthread_mutex_destroy(&pool.ranges[t].lock);
+    }
+    free(pool.ranges);
+    free(workers);
+    return 0;
+}
+
+int pool_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (int)n;
+}
@@ -0,0 +1,129 @@
+#ifndef BALLS_H
+#define BALLS_H
+
+/*
+ * Batch ball physics.
+ *
+ * A ball_batch_t holds any number of balls in structure-of-arrays form:
+ * every field lives in its own array indexed by ball. balls_step then
+ * advances the whole batch one fixed step at a time in a few passes
+ * over those arrays, which keeps the common case (a ball rolling across
+ * open grass) to a handful of loads and adds per ball. The game's own
+ * ball is just ball 0 of a batch; more balls are useful for ghosts and
+ * for simulating candidate shots.
+ *
+ * Positions and velocities are Q16.16 pixels and pixels per step.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include <stdbool.h>
+#include "fixed.h"
+#include "broadphase.h"
+#include "material.h"
+
+typedef enum {
+    BALL_RESTING = 0,   // stopped by friction
+    BALL_ROLLING,
+    BALL_IN_WATER,      // stopped on a water cell of the terrain
+    BALL_IN_HOLE,       // stopped on a hole cell of the terrain
+} ball_state_t;
+
+/*
+ * Type: 'course_t'
+ *
+ * Everything a ball can run into. The field's edges and the rectangular
+ * walls are swept exactly; the terrain map, if any, decides where a
+ * ball sinks and bounces balls off walls that have no rectangle.
+ */
+typedef struct {
+    int width, height;               // field size in pixels; its edges bounce
+    int radius;                      // ball radius in pixels
+    fix_t friction;                  // speed lost every step
+    const bp_rect_t *walls;
+    int num_walls;
+    broadphase_t *grid;              // the walls bucketed by bp_build, or NULL to test them all
+    const material_map_t *terrain;   // or NULL for plain grass everywhere
+} course_t;
+
+/*
+ * Type: 'ball_batch_t'
+ *
+ * Zero-initialize, then call balls_init.
+ */
+typedef struct {
+    int count;
+    int capacity;
+    fix_t *x, *y;             // center
+    fix_t *vx, *vy;           // velocity
+    fix_t *dir_x, *dir_y;     // (vx, vy) over speed, so friction needs no division
+    fix_t *speed;             // length of (vx, vy), so friction needs no square root
+    fix_t *prev_x, *prev_y;   // center before the last step, for interpolation
+    unsigned char *state;     // a ball_state_t
+} ball_batch_t;
+
+/*
+ * 'balls_init'
+ *
+ * Allocate room for `capacity` balls. The batch starts empty.
+ * Returns false if memory could not be allocated.
+ */
+bool balls_init(ball_batch_t *batch, int capacity);
+
+/*
+ * 'balls_free'
+ *
+ * Release the memory held by the batch.
+ */
+void balls_free(ball_batch_t *batch);
+
+/*
+ * 'balls_add'
+ *
+ * Add a resting ball at (x, y). Returns its index, or -1 if the batch
+ * is full.
+ */
+int balls_add(ball_batch_t *batch, fix_t x, fix_t y);
+
+/*
+ * 'balls_clear'
+ *
+ * Remove every ball, keeping the memory for reuse.
+ */
+void balls_clear(ball_batch_t *batch);
+
+/*
+ * 'balls_place'
+ *
+ * Move ball i to (x, y) without it travelling there, e.g. onto a tee.
+ */
+void balls_place(ball_batch_t *batch, int i, fix_t x, fix_t y);
+
+/*
+ * 'balls_launch'
+ *
+ * Give ball i the velocity (vx, vy). It starts rolling unless the
+ * velocity is zero.
+ */
+void balls_launch(ball_batch_t *batch, int i, fix_t vx, fix_t vy);
+
+/*
+ * 'balls_push_out'
+ *
+ * Move ball i out of any wall it overlaps, through the nearest face.
+ * Steps never move a ball into a wall, so this is only needed after
+ * balls_place.
+ */
+void balls_push_out(ball_batch_t *batch, int i, const course_t *course);
+
+/*
+ * 'balls_step'
+ *
+ * Advance every rolling ball by one step: move it by its velocity,
+ * bouncing off the field's edges and the walls (earliest contact first,
+ * so fast balls cannot tunnel), check the terrain under it and apply
+ * friction along its direction of travel.
+ */
+void balls_step(ball_batch_t *batch, const course_t *course);
+
+#endif
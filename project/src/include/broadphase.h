@@ -0,0 +1,111 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+/*
+ * Uniform-grid broadphase for static rectangles.
+ *
+ * The screen is cut into square cells and every shape is listed in each
+ * cell its rectangle touches. A query then only looks at the shapes in
+ * the cells it overlaps, so the cost of a collision test depends on how
+ * crowded the neighbourhood is rather than on how many shapes the level
+ * has. Shapes are identified by their index in the array the grid was
+ * built from.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include <stdbool.h>
+
+/* Bounding rectangle of a shape, in pixels */
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} bp_rect_t;
+
+/* Whether the point (x, y) lies inside r or on its edge */
+static inline bool bp_rect_contains(const bp_rect_t *r, int x, int y)
+{
+    return x >= r->x && x <= r->x + r->width && y >= r->y && y <= r->y + r->height;
+}
+
+/*
+ * Type: 'broadphase_t'
+ *
+ * The cells are stored as one packed array of shape ids, with
+ * cell_start[c] .. cell_start[c + 1] holding the ids of cell c.
+ * Zero-initialize before the first bp_build.
+ */
+typedef struct {
+    int cell_shift;             // cells are (1 << cell_shift) pixels wide
+    int cols, rows;
+    int count;                  // number of shapes
+    int *cell_start;            // cols * rows + 1 offsets into ids
+    unsigned short *ids;        // shape ids, grouped by cell
+    int ids_capacity;
+    unsigned short *results;    // scratch list returned by bp_query
+    unsigned int *stamp;        // query that last reported each shape
+    unsigned int query;
+    int shapes_capacity;
+} broadphase_t;
+
+/*
+ * 'bp_build'
+ *
+ * Bucket the `n` rectangles into a grid of cells 2^cell_shift pixels
+ * wide covering a width x height area. Parts of a rectangle outside the area go to the
+ * nearest edge cell. At most 65536 shapes are supported. Memory from a previous build is reused when it is
+ * big enough. Returns false if memory could not be allocated.
+ */
+bool bp_build(broadphase_t *bp, int width, int height, int cell_shift, const bp_rect_t rects[], int n);
+
+/*
+ * 'bp_free'
+ *
+ * Release the memory held by the grid.
+ */
+void bp_free(broadphase_t *bp);
+
+/*
+ * 'bp_query'
+ *
+ * Find every shape listed in a cell that the rectangle (x, y, w, h)
+ * touches. Each shape is reported once; these are candidates whose
+ * exact geometry still has to be tested. Sets *ids to the list, which
+ * stays valid until the next query, and returns its length.
+ */
+int bp_query(broadphase_t *bp, int x, int y, int w, int h, const unsigned short **ids);
+
+/*
+ * 'bp_any'
+ *
+ * Returns true if any shape is listed in a cell that the rectangle
+ * (x, y, w, h) touches. Cheaper than bp_query when the answer is
+ * usually no.
+ */
+static inline bool bp_any(const broadphase_t *bp, int x, int y, int w, int h)
+{
+    if (bp->count == 0) {
+        return false;
+    }
+    int c0 = x < 0 ? 0 : x >> bp->cell_shift;
+    int c1 = (x + w - 1) >> bp->cell_shift;
+    int r0 = y < 0 ? 0 : y >> bp->cell_shift;
+    int r1 = (y + h - 1) >> bp->cell_shift;
+    if (c1 >= bp->cols) c1 = bp->cols - 1;
+    if (r1 >= bp->rows) r1 = bp->rows - 1;
+    if (c1 < c0 || r1 < r0) {
+        return false;   // entirely off the top or left
+    }
+    for (int r = r0; r <= r1; r++) {
+        // the cells of a row are contiguous, so one compare covers them
+        const int *start = &bp->cell_start[r * bp->cols];
+        if (start[c1 + 1] > start[c0]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
@@ -2,7 +2,7 @@
  * 'move_bullet'
  *
  *  Move the bullet around the screen according to the elastic
- *  bouncing principle. Always starts from the bottom left corner
+ *  bouncing principle, with the golf ball's physics (balls.h). Always starts from the bottom left corner
  *  (vertical position: HEIGHT, horizontal position: 0). Differs
  *  in trajectory according to angle and start position
  *
@@ -92,7 +92,8 @@ void draw_background(void);
 /*  
  * 'hit_obstacle'
  *
- * Let the bullet reflect when hitting an obstacle
+ * Push the bullet out of any obstacle it overlaps. Bounces themselves
+ * are handled by move_bullet.
  */
 void hit_obstacle(void);
 
@@ -106,28 +107,3 @@ void hit_obstacle(void);
  * @param h: height of rect.
  */
 bool bullet_within_rect(int x, int y, int w, int h);
-
-/**
- * 'x_inbounds', 'y_inbounds'
- *
- * Check whether the x,y coordinate of the bullet is in bounds or not
- */
-bool x_inbounds(int val, int x_min, int x_max);
-bool y_inbounds(int val, int y_min, int y_max);
-
-
-/**
- * 'hit_side'
- *
- * Return 1 if hit the vertical side; return 0 if hit the horizontal side
- * @param prev_x, prev_y: previous bullet position
- * @param sqr_x, sqr_y: nearest obstacle corner to the previous position
- */
-bool hit_side(int prev_x, int prev_y, int sqr_x, int sqr_y);
-
-
-/**
- * 'abs'
- * return absolute value
- */
-int abs(int val);
@@ -0,0 +1,30 @@
+#ifndef FB_EXTRA_H
+#define FB_EXTRA_H
+
+/*
+ * Extensions to the framebuffer module (fb.c). The base interface is
+ * declared in the CS107E fb.h.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "fb.h"
+
+/*
+ * Triple-buffered mode for fb_init: the virtual framebuffer holds three
+ * screens. fb_swap_buffer posts the flip to the GPU without waiting for
+ * it, and fb_get_draw_buffer hands out the buffer that is neither on
+ * screen nor waiting to be flipped to, so drawing the next frame can
+ * overlap the previous flip.
+ */
+#define FB_TRIPLEBUFFER ((fb_mode_t)2)
+
+/*
+ * 'fb_get_display_buffer'
+ *
+ * Return the buffer the GPU is currently scanning out, i.e. the target
+ * of the last flip it acknowledged.
+ */
+void *fb_get_display_buffer(void);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+/*
+ * Q16.16 fixed-point arithmetic for the game physics, so the FPU-less
+ * build gets subpixel precision without float emulation.
+ *
+ * A fix_t holds value * 65536 in a signed 32-bit int, covering roughly
+ * +/-32767 with a resolution of 1/65536. Products and quotients go
+ * through 64-bit intermediates.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+typedef int fix_t;
+
+#define FIX_SHIFT 16
+#define FIX_ONE (1 << FIX_SHIFT)
+
+/* Angles are measured in 1024ths of a full turn, matching the 10-bit ADC */
+#define FIX_ANGLE_STEPS 1024
+
+/* 'fix_from_int': convert a whole number to fixed point */
+static inline fix_t fix_from_int(int i)
+{
+    return i * FIX_ONE;
+}
+
+/* 'fix_to_int': whole part, rounded towards zero */
+static inline int fix_to_int(fix_t f)
+{
+    return f / FIX_ONE;
+}
+
+/* 'fix_round': nearest whole number, halves rounded up */
+static inline int fix_round(fix_t f)
+{
+    return (f + FIX_ONE / 2) >> FIX_SHIFT;
+}
+
+/* 'fix_mul': product of two fixed-point values */
+static inline fix_t fix_mul(fix_t a, fix_t b)
+{
+    return (fix_t)(((long long)a * b) >> FIX_SHIFT);
+}
+
+/* 'fix_div': quotient of two fixed-point values, b must not be 0 */
+static inline fix_t fix_div(fix_t a, fix_t b)
+{
+    return (fix_t)(((long long)a * FIX_ONE) / b);
+}
+
+/*
+ * 'fix_sin', 'fix_cos'
+ *
+ * Sine and cosine of an angle given in 1024ths of a turn (any integer,
+ * taken modulo 1024), from a quarter-wave lookup table.
+ */
+fix_t fix_sin(int angle);
+fix_t fix_cos(int angle);
+
+/*
+ * 'fix_isqrt'
+ *
+ * Integer square root of a 64-bit value, rounded down.
+ */
+unsigned int fix_isqrt(unsigned long long n);
+
+/*
+ * 'fix_hypot'
+ *
+ * Length of the vector (x, y).
+ */
+fix_t fix_hypot(fix_t x, fix_t y);
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef GL_EXTRA_H
+#define GL_EXTRA_H
+
+/*
+ * Extensions to the graphics library (gl.c) used by the golf game.
+ * The base interface is declared in the CS107E gl.h; everything here
+ * is implemented alongside it in lib/gl.c.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "gl.h"
+#include "fb_extra.h"
+
+/*
+ * Triple-buffered mode for gl_init, see FB_TRIPLEBUFFER in fb_extra.h.
+ * gl_swap_buffer then returns without waiting for the flip.
+ */
+#define GL_TRIPLEBUFFER ((gl_mode_t)FB_TRIPLEBUFFER)
+
+/*
+ * 'gl_set_clip'
+ *
+ * Restrict all subsequent drawing to the rectangle with upper-left
+ * corner (x, y), width w and height h. Pixels outside the rectangle
+ * are discarded. The rectangle is intersected with the screen bounds.
+ */
+void gl_set_clip(int x, int y, int w, int h);
+
+/*
+ * 'gl_reset_clip'
+ *
+ * Make the whole screen drawable again.
+ */
+void gl_reset_clip(void);
+
+/*
+ * 'gl_clip_rect'
+ *
+ * Intersect the rectangle (*x, *y, *w, *h) with the current clip
+ * rectangle, updating it in place. Returns false if nothing is left.
+ */
+bool gl_clip_rect(int *x, int *y, int *w, int *h);
+
+/*
+ * 'gl_draw_span'
+ *
+ * Draw a horizontal run of `len` pixels starting at (x, y). The span is
+ * clipped once and written with multi-word stores, so it is the fast
+ * path for any filled shape that can be broken into rows.
+ */
+void gl_draw_span(int x, int y, int len, color_t c);
+
+/*
+ * 'gl_draw_circle'
+ *
+ * Draw a filled circle centered at (x, y) covering every pixel within
+ * distance r of the center. Each row is filled as a single span; the
+ * half-width of every row is computed once per radius and cached.
+ */
+void gl_draw_circle(int x, int y, int r, color_t c);
+
+/*
+ * 'gl_draw_ring'
+ *
+ * Draw a ring centered at (x, y) with outer radius r that is `thickness`
+ * pixels wide, i.e. the filled circle of radius r minus the filled
+ * circle of radius r - thickness.
+ */
+void gl_draw_ring(int x, int y, int r, int thickness, color_t c);
+
+/*
+ * Type: 'gl_pattern_t'
+ *
+ * A periodic texture whose pixel (x, y) is texels[(x + y * shift) mod
+ * period]. A shift of 1 gives diagonal stripes, 0 vertical ones. Any
+ * texture that repeats along a row (grass, water, hedge, sand...) can
+ * be drawn through the same fast path.
+ */
+typedef struct {
+    int period;      // number of texels before the row repeats
+    int shift;       // phase advance from one row to the next
+    int length;      // number of pixels in strip
+    color_t *strip;  // texels repeated over a full row plus one period
+} gl_pattern_t;
+
+/*
+ * 'gl_pattern_init'
+ *
+ * Build a pattern from `period` texels. Must be called after gl_init,
+ * since the pattern is expanded to the framebuffer's row length.
+ * Returns false if memory could not be allocated.
+ */
+bool gl_pattern_init(gl_pattern_t *pattern, const color_t texels[], int period, int shift);
+
+/*
+ * 'gl_pattern_free'
+ *
+ * Release the memory held by a pattern.
+ */
+void gl_pattern_free(gl_pattern_t *pattern);
+
+/*
+ * 'gl_draw_pattern_rect'
+ *
+ * Fill the rectangle (x, y, w, h) with a pattern. Each row is copied out
+ * of the pattern's strip at a rotating phase, with no per-pixel math.
+ */
+void gl_draw_pattern_rect(int x, int y, int w, int h, const gl_pattern_t *pattern);
+
+#define GL_POLYGON_MAX_VERTICES 16
+
+/*
+ * 'gl_fill_polygon'
+ *
+ * Fill the convex polygon with the `n` vertices (xs[i], ys[i]), given in
+ * either winding order, with color c. Pixels on the boundary are
+ * included. Rows are found with integer edge functions stepped from one
+ * row to the next and drawn as clipped spans. Polygons with more than
+ * GL_POLYGON_MAX_VERTICES vertices are ignored.
+ */
+void gl_fill_polygon(const int xs[], const int ys[], int n, color_t c);
+
+/*
+ * 'gl_set_draw_target'
+ *
+ * Direct all subsequent drawing into an off-screen image that has the
+ * same pitch and height as the framebuffer, e.g. one from malloc of
+ * fb_get_pitch() * fb_get_height() bytes. Pass NULL to draw to the
+ * framebuffer's draw buffer again. Off-screen drawing is never
+ * recorded as dirty.
+ */
+void gl_set_draw_target(void *pixels);
+
+/*
+ * 'gl_get_draw_target'
+ *
+ * Return the image currently being drawn to.
+ */
+void *gl_get_draw_target(void);
+
+/*
+ * 'gl_copy_rect'
+ *
+ * Copy the rectangle (x, y, w, h) of an off-screen image laid out like
+ * the framebuffer into the same place in the draw target, respecting
+ * the clip rectangle.
+ */
+void gl_copy_rect(const void *src, int x, int y, int w, int h);
+
+/*
+ * Type: 'gl_repaint_fn_t'
+ *
+ * Client function that redraws the static background inside the given
+ * rectangle. The clip rectangle is set to the region while it runs.
+ */
+typedef void (*gl_repaint_fn_t)(int x, int y, int w, int h);
+
+/*
+ * 'gl_dirty_init'
+ *
+ * Start tracking dirty rectangles, using `repaint` to restore the
+ * background. Every buffer is considered fully dirty afterwards.
+ */
+void gl_dirty_init(gl_repaint_fn_t repaint);
+
+/*
+ * 'gl_dirty_add'
+ *
+ * Record that a sprite was drawn over the background inside the given
+ * rectangle of the current draw buffer. The region is restored the
+ * next time this buffer is drawn to.
+ */
+void gl_dirty_add(int x, int y, int w, int h);
+
+/*
+ * 'gl_dirty_invalidate'
+ *
+ * Record that the background itself changed inside the given
+ * rectangle, so it has to be repainted in every buffer.
+ */
+void gl_dirty_invalidate(int x, int y, int w, int h);
+
+/*
+ * 'gl_dirty_restore'
+ *
+ * Repaint every dirty region of the current draw buffer from the
+ * background and forget them. Call once per frame before drawing sprites.
+ */
+void gl_dirty_restore(void);
+
+#endif
@@ -1,40 +1,5 @@
-/* Struct ball: Info on pos and vel */
-typedef struct{
-    int x_pos;
-    int y_pos;
-    int x_vel;
-    int y_vel;
-} ball_t;
-
-/* Struct lake: Info on pos and size */
-typedef struct{
-    int x_pos;
-    int y_pos;
-    int width;
-    int height;
-} lake_t;
-
-/* Struct obs: Info on pos and size */
-typedef struct{
-    int x_start;
-    int y_start;
-    int width;
-    int height;
-} obs_t;
-
-/* Struct goal: Info on pos and size */
-typedef struct{
-    int x_pos;
-    int y_pos;
-    int width;
-    int height;
-} goal_t;
-
-/*
- * 'gl_draw_circle'
- *  draw a circle of given origin and radius
- */
-void gl_draw_circle(int x, int y, int r, color_t color);
+#include "fixed.h"
+#include "level.h"
 
 /*
  * 'ball_init'
@@ -49,14 +14,59 @@ void ball_init(int angle, int start_position);
 /*
  * 'goal_init'
  *
- * Set up the position and size of the goal hole in minigulf round.
+ * Set up the position and size of the goal hole in minigulf round. The
+ * goal is moved until a search of the player's shots (see reach.h)
+ * finds it can be reached from the tee within five shots, and the lakes
+ * and walls are laid out again if it never can. If the search runs out
+ * of time first, the level is left an open course (see levelgen.h).
  */
 void goal_init(void);
 
+/*
+ * 'golf_load_level'
+ *
+ * Play the given level record (see level.h) in place of a generated
+ * one and put the ball on its tee. The record is used where it lies,
+ * e.g. in a pack linked into the image, and must stay there for as long
+ * as the level is played. `bytes` is how much memory the record may
+ * span, e.g. up to the end of its pack. Returns false if it is not a
+ * valid record.
+ */
+bool golf_load_level(const level_t *level, size_t bytes);
+
+/*
+ * 'golf_next_level'
+ *
+ * Start a level picked at random from the RAND_LEVEL stream among the
+ * levels linked into the image, with the ball on its tee. Nothing is
+ * generated at round start unless no levels are linked in.
+ */
+void golf_next_level(void);
+
+/*
+ * 'ball_tee'
+ *
+ * Put the ball back on the current level's tee, at rest.
+ */
+void ball_tee(void);
+
+/*
+ * 'level_par'
+ *
+ * Par of the current level: for a generated one, the fewest shots from
+ * the tee that goal_init found for sinking the ball, or -1 if it ran
+ * out of time and left an open course (or had no memory to search).
+ */
+int level_par(void);
+
 /*
  * 'lake_init'
  *
- * Set up the position and size of all lake-type obstacles.
+ * Set up the size of all lake-type obstacles. This starts a new
+ * generated level, drawn from a seed that alone determines its layout:
+ * follow it with wall_init and goal_init, which place the walls, then
+ * the lakes around them, then the goal, keeping them all apart (see
+ * layout.h).
  */
 void lake_init(void);
 
@@ -88,18 +98,41 @@ int get_strength(void);
  *
  * Reads input from the MCP3008 / potentiometer to modify
  * the angle with which the ball is shot. Draws a line / cursor in
- * the direction of the current shot trajectory.
+ * the direction of the current shot trajectory, and a dotted path
+ * predicted by running the physics ahead through the first few bounces.
+ * The path is only re-simulated when the angle, strength or tee changes.
  */
 void get_angle(void);
 
+/* 'move_ball'
+ *
+ * Advance the ball by one step of velocity with balls_step (balls.h):
+ * it is swept as a circle of radius RADIUS against the walls and the
+ * screen edges, then friction slows it along its direction of travel.
+ */
 void move_ball(void);
 
+/* 'step_ball'
+ *
+ * Run one fixed-length physics step: hit_wall, then move_ball. The
+ * position before the step is kept for draw_ball_at.
+ */
+void step_ball(void);
+
 /* 'draw_ball'
  *
- * Draw the ball onto the framebuffer
+ * Draw the ball onto the framebuffer at its current position and show it
  */
 void draw_ball(void);
 
+/* 'draw_ball_at'
+ *
+ * Same as draw_ball, but at the fraction alpha (FIX_ONE = all the way)
+ * of the last step between the position before step_ball and the
+ * current one, so motion looks smooth between physics steps.
+ */
+void draw_ball_at(fix_t alpha);
+
 /*
  * 'ball_within_rect'
  * 
@@ -112,53 +145,102 @@ void draw_ball(void);
  */
 bool ball_within_rect(int x, int y, int w, int h);
 
+/*
+ * 'get_ball_xvel', 'get_ball_yvel'
+ *
+ * Whole pixels per frame of the ball's velocity, rounded towards zero.
+ */
 int get_ball_xvel(void);
 
 int get_ball_yvel(void);
 
 /*
- * 'hit_wall'
+ * 'get_ball_position'
  *
+ * The ball's exact position, in Q16.16 pixels (see fixed.h).
  */
-void hit_wall(void);
+void get_ball_position(fix_t *x, fix_t *y);
 
 /*
- * 'hit_lake'
+ * 'golf_set_headless'
+ *
+ * Turn drawing off (or back on). The game runs exactly the same
+ * without it, e.g. to replay a recorded game quickly (see replay.h).
  */
-bool hit_lake(void);
+void golf_set_headless(bool enabled);
 
-/* 'draw_field'
+/*
+ * 'ball_at_rest'
  *
- * Redraw static background such as obstacles and goal
+ * Returns true once friction has brought the ball to a complete stop.
+ */
+bool ball_at_rest(void);
 
- @ param: parity indicates the simple back-and-forth movement graphics of
- objects in the game. 1 indicates one state while 0 indicates the other.
+/*
+ * 'hint_update'
+ *
+ * Continue searching for the best shot from the ball's spot (see
+ * solver.h) for at most about budget_us microseconds. The search starts
+ * over whenever the ball or the level moves. Returns true once every
+ * shot has been tried.
  */
-void draw_field(int parity);
+bool hint_update(unsigned int budget_us);
 
 /*
- * 'x_inbounds'
+ * 'hint_best'
  *
+ * Rotor position and strength of the best shot, once hint_update has
+ * finished the search for the ball's current spot. Returns false before.
  */
-bool x_inbounds(int val, int x_min, int x_max);
+bool hint_best(unsigned int *pos, int *strength);
 
 /*
- * 'y_inbounds'
+ * 'draw_hint'
  *
+ * Draw the best shot's aim line in yellow, if the search has finished.
  */
-bool y_inbounds(int val, int y_min, int y_max);
+void draw_hint(void);
 
-/* 'hit_goal'
+/*
+ * 'take_best_shot'
  *
- * Check whether the ball has hit the goal or not
+ * Launch the ball along the best shot, for the computer player.
+ * Returns false if the search has not finished yet.
  */
-bool hit_goal(void);
+bool take_best_shot(void);
+
+/*
+ * 'hit_wall'
+ *
+ * Push the ball out of any wall it overlaps, e.g. after being placed on
+ * a new tee. Bounces themselves are handled by move_ball.
+ */
+void hit_wall(void);
 
 /*
- * 'hit_boundary'
+ * 'hit_lake'
+ *
+ * Check whether the ball is in any lake, with one lookup of the
+ * level's material map under the ball's center.
+ */
+bool hit_lake(void);
+
+/* 'draw_field'
+ *
+ * Redraw static background such as obstacles and goal. Only the regions
+ * that sprites were drawn over (or that changed with parity) since this
+ * buffer was last drawn are repainted; a new level repaints everything.
+
+ @ param: parity indicates the simple back-and-forth movement graphics of
+ objects in the game. 1 indicates one state while 0 indicates the other.
+ */
+void draw_field(int parity);
+
+/* 'hit_goal'
  *
+ * Check whether the ball has hit the goal or not, from the material map
  */
-bool hit_boundary(int prev_x, int prev_y, int sqr_x, int sqr_y);
+bool hit_goal(void);
 
 /**
  * 'abs'
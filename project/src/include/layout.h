@@ -0,0 +1,77 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+/*
+ * Level layout with bounded generation time.
+ *
+ * A layout is the set of rectangles already placed on the field. Each
+ * new shape is placed by grid-jittered sampling: the range its corner
+ * may take is cut into a LAYOUT_GRID x LAYOUT_GRID grid, the cells are
+ * visited in a random order, and the first random spot in a cell where
+ * the shape keeps `clearance` pixels from everything placed so far is
+ * taken. A shape that fits nowhere is reported instead of retried, so
+ * one placement costs at most LAYOUT_GRID^2 candidates times the shapes
+ * already placed, however crowded the level gets.
+ *
+ * Shapes carry a caller-defined kind, so one kind (e.g. the lakes) can
+ * be taken out and placed again around the others.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include <stdbool.h>
+#include "broadphase.h"
+#include "rng.h"
+
+#define LAYOUT_MAX_SHAPES 64
+#define LAYOUT_GRID 8
+
+typedef struct {
+    int clearance;              // smallest gap allowed between two shapes
+    rng_t *rng;                 // where the random spots come from
+    int count;
+    bp_rect_t shapes[LAYOUT_MAX_SHAPES];
+    int kinds[LAYOUT_MAX_SHAPES];
+} layout_t;
+
+/*
+ * 'layout_init'
+ *
+ * Start an empty layout. Shapes may run off the field's edges; keeping
+ * them on it is up to the corner ranges given to layout_place.
+ */
+void layout_init(layout_t *layout, int clearance, rng_t *rng);
+
+/*
+ * 'layout_remove'
+ *
+ * Take every shape of the given kind out of the layout.
+ */
+void layout_remove(layout_t *layout, int kind);
+
+/*
+ * 'layout_fits'
+ *
+ * Whether rect keeps the clearance from every shape in the layout.
+ */
+bool layout_fits(const layout_t *layout, const bp_rect_t *rect);
+
+/*
+ * 'layout_add'
+ *
+ * Add rect as it is, e.g. to keep an area such as the tee free.
+ * Returns false if the layout is full.
+ */
+bool layout_add(layout_t *layout, const bp_rect_t *rect, int kind);
+
+/*
+ * 'layout_place'
+ *
+ * Find a spot for a w x h shape whose upper-left corner lies in
+ * `corners` (x .. x + width, y .. y + height), add it and store it in
+ * *out. Returns false, leaving the layout as it was, if no sampled spot
+ * fits or the layout is full.
+ */
+bool layout_place(layout_t *layout, int w, int h, const bp_rect_t *corners, int kind, bp_rect_t *out);
+
+#endif
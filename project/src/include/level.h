@@ -0,0 +1,98 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+/*
+ * Binary level format.
+ *
+ * A level is one self-contained record: a fixed header (tee, goal, par
+ * and the seed it was generated from) followed by its shapes, each a
+ * rectangle of one material. Shapes are listed in the order they are
+ * painted, so a later shape covers an earlier one. Records are padded
+ * to a multiple of 4 bytes and can be laid end to end into a pack.
+ *
+ * The format is little-endian, as on both the Pi and the host tools
+ * that write it, and the game uses a record in place: loading a level
+ * checks the header and keeps a pointer to it, so a level costs the
+ * same to start whether it was generated into RAM or linked into the
+ * image. Curated packs are linked into .rodata between
+ * __levels_start__ and __levels_end__ (see src/boot/memmap).
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "material.h"
+
+#define LEVEL_MAGIC 0x4c464c47      // "GLFL" in memory
+#define LEVEL_VERSION 1
+#define LEVEL_MAX_SHAPES 255
+
+typedef struct {
+    int16_t x, y, width, height;
+    uint8_t material;               // a material_t
+    uint8_t reserved;               // 0
+} level_shape_t;
+
+typedef struct {
+    uint32_t magic;                 // LEVEL_MAGIC
+    uint16_t version;               // LEVEL_VERSION
+    uint16_t size;                  // bytes in the record, shapes and padding included
+    uint32_t seed;                  // seed the level was generated from, 0 if built by hand
+    int16_t tee_x, tee_y;           // where the ball starts
+    level_shape_t goal;             // the hole, always MAT_HOLE
+    int8_t par;                     // fewest shots known to sink the ball, -1 if unknown
+    uint8_t num_shapes;
+    level_shape_t shapes[];
+} level_t;
+
+/* Bytes needed for a record with n shapes */
+#define LEVEL_BYTES(n) ((sizeof(level_t) + (n) * sizeof(level_shape_t) + 3) & ~3u)
+
+/* Bounds of the curated packs linked into the image */
+extern const char __levels_start__[], __levels_end__[];
+
+/*
+ * 'level_init'
+ *
+ * Start an empty record with the given seed: tee and goal at the
+ * origin, par unknown and no shapes. `level` must be 4-byte aligned.
+ */
+void level_init(level_t *level, unsigned int seed);
+
+/*
+ * 'level_add'
+ *
+ * Append a w x h rectangle of material m with its upper-left corner at
+ * (x, y). Returns false if the record already has max_shapes shapes.
+ */
+bool level_add(level_t *level, int max_shapes, int x, int y, int w, int h, material_t m);
+
+/*
+ * 'level_remove'
+ *
+ * Take out every shape of material m, keeping the others in order.
+ */
+void level_remove(level_t *level, material_t m);
+
+/*
+ * 'level_valid'
+ *
+ * Whether the `bytes` bytes at `level` start with a well-formed record
+ * of this version: its header fits and every shape is of a known
+ * material.
+ */
+bool level_valid(const level_t *level, size_t bytes);
+
+/*
+ * 'level_first', 'level_next'
+ *
+ * Walk the records packed between start and end: the first one, and
+ * the one after `level`. Both return NULL at the end of the pack or at
+ * a malformed record.
+ */
+const level_t *level_first(const void *start, const void *end);
+const level_t *level_next(const level_t *level, const void *end);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef LEVELGEN_H
+#define LEVELGEN_H
+
+/*
+ * Random level generation, shared by the game and the host level farm.
+ *
+ * A generated level is drawn entirely from its seed: lakes of random
+ * sizes and walls from fixed templates are placed apart with a layout
+ * (see layout.h), then the goal, which is moved until a search of the
+ * player's shots (see reach.h) finds it can be holed in LEVELGEN_MAX_SHOTS
+ * shots; a layout where it never can is drawn again from a new seed.
+ * The fewest shots found becomes the level's par. The searches of a
+ * level share a budget of ball steps, and if it runs out first the
+ * walls and lakes are dropped: the open course left has a par of -1,
+ * as does a level that could not be checked for want of memory.
+ *
+ * Also here is the physics view of any level record, generated or
+ * loaded: its walls, their broadphase and its material map.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "level.h"
+#include "layout.h"
+#include "reach.h"
+#include "balls.h"
+#include "material.h"
+
+/* The field and the ball the game plays with */
+#define LEVELGEN_WIDTH 640
+#define LEVELGEN_HEIGHT 512
+#define LEVELGEN_RADIUS 5
+#define LEVELGEN_FRICTION (FIX_ONE / 5)       // speed lost every frame, in px/frame
+#define LEVELGEN_SHOT_SPEED (6 * FIX_ONE)     // shot speed per strength level, in px/frame
+#define LEVELGEN_MAX_SHOTS 5                  // as many as the player gets
+#define LEVELGEN_LAKES 3
+
+/*
+ * Ball steps the goal checks of one level may simulate (see reach.h).
+ * Generating a level on the Pi must not stall a new round, so this is
+ * LEVELGEN_BUDGET_US worth of steps at the rate balls_step runs there
+ * (test_levelgen_budget in project-tests.c measures both).
+ */
+#define LEVELGEN_BUDGET_US 250000
+#define LEVELGEN_PI_STEPS_PER_MS 400
+#define LEVELGEN_REACH_BUDGET (LEVELGEN_BUDGET_US / 1000 * LEVELGEN_PI_STEPS_PER_MS)
+#define LEVELGEN_EXHAUSTIVE (-1)              // a budget that lets every check run to its end, for the host
+
+/*
+ * Type: 'level_course_t'
+ *
+ * A level made playable. Zero-initialize before the first build.
+ */
+typedef struct {
+    bp_rect_t walls[LEVEL_MAX_SHAPES];
+    broadphase_t grid;
+    material_map_t terrain;
+    bool grid_ready;        // false if the grid could not be allocated
+    bool terrain_ready;     // false if the map could not be allocated
+    course_t course;        // what balls_step runs against
+} level_course_t;
+
+/*
+ * 'level_course_build'
+ *
+ * Build the course for a level, reusing memory from the previous one.
+ * Out of memory, the course goes without the grid or the map (see
+ * course_t) and false is returned.
+ */
+bool level_course_build(level_course_t *field, const level_t *level);
+
+/*
+ * 'level_course_free'
+ *
+ * Release the memory held by the course.
+ */
+void level_course_free(level_course_t *field);
+
+/*
+ * Type: 'levelgen_t'
+ *
+ * Scratch space of a generator. Zero-initialize; each thread needs its own.
+ */
+typedef struct {
+    int budget;             // ball steps per level: 0 for LEVELGEN_REACH_BUDGET, or LEVELGEN_EXHAUSTIVE
+    rng_t rng;              // seeded from the level's seed
+    int lake_widths[LEVELGEN_LAKES], lake_heights[LEVELGEN_LAKES];
+    int lakes_pending;      // lakes drawn by levelgen_lakes but not yet placed
+    layout_t layout;
+    bool layout_ready;
+    reach_t reach;
+    bool reach_ready;
+} levelgen_t;
+
+/*
+ * 'levelgen_lakes', 'levelgen_walls', 'levelgen_goal'
+ *
+ * The steps of generating a level into `level`, which must have room for
+ * LEVEL_MAX_SHAPES shapes. levelgen_lakes starts a new record from the
+ * seed and draws the lakes' sizes; levelgen_walls places the walls and
+ * then the lakes around them; levelgen_goal places the goal (and the
+ * lakes, if levelgen_walls was skipped), using `field` to check it and
+ * leaving it built for the level, and sets the par.
+ */
+void levelgen_lakes(levelgen_t *gen, level_t *level, unsigned int seed);
+void levelgen_walls(levelgen_t *gen, level_t *level);
+void levelgen_goal(levelgen_t *gen, level_t *level, level_course_t *field);
+
+/*
+ * 'levelgen_make'
+ *
+ * All three steps: the level the game generates from this seed.
+ */
+void levelgen_make(levelgen_t *gen, level_t *level, unsigned int seed, level_course_t *field);
+
+/*
+ * 'levelgen_free'
+ *
+ * Release the memory held by the generator.
+ */
+void levelgen_free(levelgen_t *gen);
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+/*
+ * Rasterized material map of a level.
+ *
+ * The playing field is divided into square cells of 2^cell_shift pixels
+ * and each cell records what the ball would find there: grass, wall,
+ * water or the hole. Cells take 2 bits, packed four to a byte. Once a
+ * level is rasterized, any terrain query is a single table lookup, no
+ * matter how many shapes the level has or what shape they are.
+ *
+ * A second channel stores, for every cell on the edge of a region, the
+ * direction pointing out of that region, for bouncing off shapes that
+ * have no exact geometry.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include <stdbool.h>
+
+typedef enum {
+    MAT_GRASS = 0,
+    MAT_WALL = 1,
+    MAT_WATER = 2,
+    MAT_HOLE = 3,
+} material_t;
+
+/*
+ * Type: 'material_map_t'
+ *
+ * Zero-initialize before the first mm_init.
+ */
+typedef struct {
+    int cell_shift;           // cells are (1 << cell_shift) pixels wide
+    int cols, rows;
+    unsigned char *cells;     // 2-bit materials, four cells per byte
+    unsigned char *normals;   // outward normal per cell: x in the low nibble, y in the high one
+    int capacity;             // cells allocated
+} material_map_t;
+
+/*
+ * 'mm_init'
+ *
+ * Size the map to cover a width x height field and fill it with grass.
+ * Memory from a previous level is reused when it is big enough.
+ * Returns false if memory could not be allocated.
+ */
+bool mm_init(material_map_t *map, int width, int height, int cell_shift);
+
+/*
+ * 'mm_free'
+ *
+ * Release the memory held by the map.
+ */
+void mm_free(material_map_t *map);
+
+/*
+ * 'mm_fill_rect', 'mm_fill_circle', 'mm_fill_polygon'
+ *
+ * Paint a material into every cell whose center lies inside the shape.
+ * Later shapes overwrite earlier ones. Polygons may be concave, with at
+ * most 16 vertices in either winding order.
+ */
+void mm_fill_rect(material_map_t *map, int x, int y, int w, int h, material_t m);
+void mm_fill_circle(material_map_t *map, int cx, int cy, int r, material_t m);
+void mm_fill_polygon(material_map_t *map, const int xs[], const int ys[], int n, material_t m);
+
+/*
+ * 'mm_finish'
+ *
+ * Compute the normal channel. Call once after the last fill.
+ */
+void mm_finish(material_map_t *map);
+
+/*
+ * 'mm_at'
+ *
+ * Material under pixel (x, y). Everything off the map is wall.
+ */
+static inline material_t mm_at(const material_map_t *map, int x, int y)
+{
+    unsigned int col = x >> map->cell_shift;
+    unsigned int row = y >> map->cell_shift;
+    if (x < 0 || y < 0 || col >= (unsigned int)map->cols || row >= (unsigned int)map->rows) {
+        return MAT_WALL;
+    }
+    unsigned int cell = row * map->cols + col;
+    return (material_t)((map->cells[cell >> 2] >> ((cell & 3) * 2)) & 3);
+}
+
+/*
+ * 'mm_normal'
+ *
+ * Direction out of the region under pixel (x, y), with each component
+ * in -3..3 and not normalized. Both are 0 inside a region, where every
+ * neighbouring cell has the same material, and off the map.
+ */
+void mm_normal(const material_map_t *map, int x, int y, int *nx, int *ny);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef PROF_H
+#define PROF_H
+
+/*
+ * Frame-stage profiler built on timer_get_ticks.
+ *
+ * Wrap the code to measure in a block that opens with a named scoped timer:
+ *
+ *     { PROF_SCOPE("draw_field"); draw_field(parity); }
+ *
+ * The time from PROF_SCOPE to the end of the enclosing block is recorded
+ * under that name. Each stage keeps its last PROF_WINDOW samples, from
+ * which min/avg/max/p99 are reported, either on screen (prof_draw_hud)
+ * or over the UART (prof_dump).
+ *
+ * Everything here compiles to nothing unless PROFILE is defined
+ * (`make PROFILE=1`), so release builds pay nothing.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include <stdbool.h>
+
+#define PROF_MAX_STAGES 16
+#define PROF_WINDOW 128
+
+#ifdef PROFILE
+
+typedef struct {
+    int stage;
+    unsigned int start;
+} prof_scope_t;
+
+/*
+ * 'prof_begin', 'prof_end'
+ *
+ * Used by PROF_SCOPE. `prof_begin` registers the stage on first use
+ * (caching its index in *stage) and starts the timer; `prof_end` runs
+ * when the scope exits and records the elapsed microseconds.
+ */
+prof_scope_t prof_begin(int *stage, const char *name);
+void prof_end(prof_scope_t *scope);
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+#define PROF_SCOPE(name)                                                      \
+    static int PROF_CONCAT(prof_stage_, __LINE__) = -1;                       \
+    prof_scope_t PROF_CONCAT(prof_scope_, __LINE__)                           \
+        __attribute__((cleanup(prof_end), unused)) =                          \
+        prof_begin(&PROF_CONCAT(prof_stage_, __LINE__), name)
+
+/*
+ * 'prof_set_hud'
+ *
+ * Turn the on-screen overlay drawn by prof_draw_hud on or off.
+ */
+void prof_set_hud(bool enabled);
+
+/*
+ * 'prof_draw_hud'
+ *
+ * If the overlay is on, draw "name avg/p99" (usecs) for each stage in
+ * the top-left corner of the draw buffer. Call once per frame before
+ * swapping.
+ */
+void prof_draw_hud(void);
+
+/*
+ * 'prof_dump'
+ *
+ * Print min/avg/max/p99 (in usecs) of every stage over the UART.
+ */
+void prof_dump(void);
+
+/*
+ * 'prof_reset'
+ *
+ * Discard all samples collected so far.
+ */
+void prof_reset(void);
+
+#else
+
+#define PROF_SCOPE(name) do { } while (0)
+#define prof_set_hud(enabled) ((void)(enabled))
+#define prof_draw_hud() ((void)0)
+#define prof_dump() ((void)0)
+#define prof_reset() ((void)0)
+
+#endif
+
+#endif
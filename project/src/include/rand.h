@@ -4,15 +4,60 @@
  * Author: Philip Levis <pal@cs.stanford.edu>
  *         Pat Hanrahan <hanrahan@cs.stanford.edu>
  * Date: Jan 24, 2016
+ *
+ * Each subsystem draws from its own global stream, so for instance the
+ * computer player thinking longer never changes the next level. The
+ * streams are generators from rng.h jumped apart from one seed.
  */
 
+#include <stdbool.h>
+#include "rng.h"
+
+typedef enum {
+    RAND_LEVEL = 0,     // level layout; what rand() draws from
+    RAND_AI,            // computer player and hints
+    RAND_EFFECTS,       // purely visual randomness
+    RAND_NUM_STREAMS,
+} rand_stream_t;
 
 /*
  * `rand`
  *
- * Generate a 32-bit random number. Uses a psuedo-random
- * generator with a fixed seed.
+ * Generate a 32-bit random number from the RAND_LEVEL stream.
  *
  * @return   pseudo-random value in the range 0 to UINT_MAX
  */
 unsigned int rand(void);
+
+/*
+ * `rand_below`
+ *
+ * Uniform random number in 0 .. bound - 1 from the RAND_LEVEL stream,
+ * without the bias of rand() % bound.
+ */
+unsigned int rand_below(unsigned int bound);
+
+/*
+ * `rand_seed`
+ *
+ * Reseed every stream from `seed`, so the sequences that follow are
+ * the same every time that seed is used. Until this is called, the
+ * streams start from a fixed seed.
+ */
+void rand_seed(unsigned int seed);
+
+/*
+ * `rand_entropy`
+ *
+ * A seed that differs from run to run: the free-running microsecond
+ * counter, which depends on how long the player took to get here.
+ */
+unsigned int rand_entropy(void);
+
+/*
+ * `rand_stream`
+ *
+ * The generator behind one subsystem's stream, for use with the rng_*
+ * functions (e.g. rng_below, rng_fill).
+ */
+rng_t *rand_stream(rand_stream_t stream);
@@ -0,0 +1,88 @@
+#ifndef REACH_H
+#define REACH_H
+
+/*
+ * Reachability check for generated levels.
+ *
+ * Breadth-first search over the shots a player can take: from the tee,
+ * every one of `angles` evenly spaced rotor directions at every
+ * strength is simulated to rest on the real physics (balls.h), and each
+ * new spot the ball stops on becomes a position to shoot from next.
+ * Spots are pruned through a coarse visited grid, so positions a few
+ * pixels apart are only expanded once. A ball in the water goes back
+ * to the tee, which has already been visited.
+ *
+ * The search is bounded by a budget of ball steps rather than a clock,
+ * so the same level always gets the same answer (replays depend on it)
+ * and the worst case is the budget's ball steps, plus one ball launch
+ * per shot. Each cell of the visited grid is expanded at most once, so
+ * a budget of REACH_EXHAUSTIVE(...) always lets the search finish.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "balls.h"
+
+#define REACH_STRENGTHS 5
+#define REACH_CELL_SHIFT 4      // visited grid cells are 16 px
+
+/* Ball steps that searching every cell of a width x height course can take */
+#define REACH_EXHAUSTIVE(width, height, angles, max_steps) \
+    ((((width) >> REACH_CELL_SHIFT) + 1) * (((height) >> REACH_CELL_SHIFT) + 1) * \
+     (angles) * REACH_STRENGTHS * (max_steps))
+
+typedef enum {
+    REACH_YES = 0,          // the hole can be made within max_shots
+    REACH_NO,               // every position was explored and it cannot
+    REACH_UNKNOWN,          // the budget ran out first
+} reach_result_t;
+
+typedef struct {
+    const course_t *course;
+    fix_t tee_x, tee_y;
+    fix_t shot_speed;       // speed per strength level
+    int angles;             // directions tried from each position, dividing FIX_ANGLE_STEPS
+    int max_shots;          // shots the player has to finish the level
+    int max_steps;          // a ball still rolling after this is taken where it is
+    int budget;             // most ball steps simulated in one reach_check
+} reach_problem_t;
+
+/*
+ * Type: 'reach_t'
+ *
+ * Scratch space for searches. Zero-initialize, then call reach_init.
+ */
+typedef struct {
+    ball_batch_t batch;     // one position's shots
+    unsigned char *visited; // one byte per grid cell
+    int cols, rows;
+    fix_t *queue_x, *queue_y;
+    unsigned char *queue_shots;
+    int queue_capacity;
+    int spent;              // ball steps the last reach_check simulated
+} reach_t;
+
+/*
+ * 'reach_init'
+ *
+ * Allocate scratch space for searching problems like this one (same
+ * course size and number of angles). Returns false if out of memory.
+ */
+bool reach_init(reach_t *reach, const reach_problem_t *problem);
+
+/*
+ * 'reach_free'
+ *
+ * Release the memory held by the scratch space.
+ */
+void reach_free(reach_t *reach);
+
+/*
+ * 'reach_check'
+ *
+ * Search for the fewest shots that sink the ball from the tee. Stores
+ * that number in *shots when the answer is REACH_YES.
+ */
+reach_result_t reach_check(reach_t *reach, const reach_problem_t *problem, int *shots);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+/*
+ * Input recording and replay.
+ *
+ * Every input the game reads goes through the replay_* stand-ins below
+ * instead of the driver call they are named after. Normally they just
+ * call the driver. While recording, each value read is also appended
+ * to a log; while playing, the values come from the log instead, so the
+ * game takes exactly the path it took when the log was made. Waits are
+ * skipped during playback, so with rendering switched off as well
+ * (golf_set_headless) a whole game replays in milliseconds.
+ *
+ * The log is a byte stream of events, one per input read:
+ *
+ *     FRAME                     1 byte, marks the start of a frame
+ *     GPIO                      1 byte, the level is in the tag
+ *     ADC same as last          1 byte, channel in the tag
+ *     ADC                       3 bytes, channel in the tag, 10-bit value
+ *     TICKS                     1 byte + delta since last TICKS, LEB128
+ *     KEY                       2 bytes
+ *     SEED, CHECK               5 bytes
+ *
+ * so a frame of steady aiming costs a handful of bytes. A recording
+ * starts by seeding rand, and CHECK events hold game state (such as
+ * where the ball stopped) that playback compares against.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include <stdbool.h>
+
+typedef enum {
+    REPLAY_OFF = 0,     // live input, nothing recorded
+    REPLAY_RECORDING,
+    REPLAY_PLAYING,
+} replay_mode_t;
+
+/*
+ * 'replay_record'
+ *
+ * Seed rand with `seed` and start logging every input into buf, which
+ * holds `capacity` bytes. Recording stops by itself if buf fills up.
+ */
+void replay_record(unsigned char *buf, int capacity, unsigned int seed);
+
+/*
+ * 'replay_play'
+ *
+ * Start feeding inputs from a log made by replay_record, seeding rand
+ * the way the recording did. If the game asks for a different kind of
+ * input than the log holds next, or the log runs out, playback stops
+ * and input is live again.
+ */
+void replay_play(const unsigned char *log, int length);
+
+/*
+ * 'replay_stop'
+ *
+ * Go back to live input. Returns the length of the log just recorded,
+ * or -1 if it did not fit in its buffer.
+ */
+int replay_stop(void);
+
+/*
+ * 'replay_mode'
+ *
+ * Whether inputs are currently live, being recorded or being played.
+ */
+replay_mode_t replay_mode(void);
+
+/*
+ * 'replay_mismatches'
+ *
+ * Number of CHECK values and input kinds that did not match the log
+ * since replay_play. 0 after a faithful replay.
+ */
+int replay_mismatches(void);
+
+/*
+ * 'replay_frame'
+ *
+ * Mark the start of a frame, keeping playback aligned with the frames
+ * of the recording.
+ */
+void replay_frame(void);
+
+/*
+ * 'replay_check'
+ *
+ * While recording, log `value`; while playing, compare it with the
+ * logged one and count a mismatch if they differ.
+ */
+void replay_check(int value);
+
+/* Stand-ins for the driver calls of the same name */
+unsigned int replay_mcp3008_read(unsigned int channel);
+unsigned int replay_gpio_read(unsigned int pin);
+unsigned char replay_keyboard_read_next(void);
+unsigned int replay_timer_get_ticks(void);
+void replay_timer_delay(unsigned int secs);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef RNG_H
+#define RNG_H
+
+/*
+ * Random number generator with explicit state (xoshiro128**).
+ *
+ * Each rng_t is an independent generator: whoever owns one decides how
+ * it is seeded and nobody else moves it along. Streams that must not
+ * overlap are made by seeding one generator and calling rng_jump on
+ * copies of it, which skips 2^64 numbers each time.
+ *
+ * The global, per-subsystem streams behind rand() are in rand.h.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+typedef struct {
+    unsigned int s[4];
+} rng_t;
+
+/*
+ * 'rng_seed'
+ *
+ * Set the state from a 32-bit seed. Every seed, 0 included, gives a
+ * valid, well-mixed state.
+ */
+void rng_seed(rng_t *rng, unsigned int seed);
+
+/*
+ * 'rng_next'
+ *
+ * Next 32 random bits.
+ */
+static inline unsigned int rng_next(rng_t *rng)
+{
+    unsigned int *s = rng->s;
+    unsigned int x = s[1] * 5;
+    unsigned int result = ((x << 7) | (x >> 25)) * 9;
+    unsigned int t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+    return result;
+}
+
+/*
+ * 'rng_jump'
+ *
+ * Advance the generator by 2^64 numbers, as if rng_next had been called
+ * that many times. Jumped copies of one generator never overlap.
+ */
+void rng_jump(rng_t *rng);
+
+/*
+ * 'rng_below'
+ *
+ * Uniform integer in 0 .. bound - 1 with no modulo bias (Lemire's
+ * multiply-shift with rejection; usually one multiply, no division).
+ * Returns 0 if bound is 0.
+ */
+unsigned int rng_below(rng_t *rng, unsigned int bound);
+
+/*
+ * 'rng_fill'
+ *
+ * Store the next n random words in out, the same ones n calls to
+ * rng_next would give, with the state kept in registers throughout.
+ */
+void rng_fill(rng_t *rng, unsigned int out[], int n);
+
+#endif
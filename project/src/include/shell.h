@@ -7,6 +7,8 @@
  * Last update: February 2019
  */
 
+#include <stddef.h>
+
 /*
  * Type: `input_fn_t`
  *
@@ -0,0 +1,60 @@
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+/*
+ * Fixed-timestep clock for running the simulation at a constant rate,
+ * independent of how long each rendered frame takes.
+ *
+ * Each frame, sim_clock_advance adds the time elapsed since the last
+ * call (from timer_get_ticks) to an accumulator and reports how many
+ * whole steps are due. Whatever is left over, as a fraction of a step,
+ * is available from sim_clock_alpha for interpolating between the
+ * previous and current simulation states. The timer is read through
+ * replay.h, so a replayed game sees the recorded times.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "fixed.h"
+
+typedef struct {
+    unsigned int step_us;       // length of one simulation step
+    unsigned int last_ticks;    // timer_get_ticks at the previous advance
+    unsigned int accumulator;   // time not yet simulated, in usecs
+    int max_steps;              // most steps run in one frame
+} sim_clock_t;
+
+/*
+ * 'sim_clock_init'
+ *
+ * Start a clock with steps of step_us microseconds, now. At most
+ * max_steps are reported per frame; time beyond that is dropped, so a
+ * long stall slows the game down instead of freezing it while the
+ * simulation catches up.
+ */
+void sim_clock_init(sim_clock_t *clock, unsigned int step_us, int max_steps);
+
+/*
+ * 'sim_clock_reset'
+ *
+ * Forget the time elapsed so far, e.g. after waiting for input.
+ */
+void sim_clock_reset(sim_clock_t *clock);
+
+/*
+ * 'sim_clock_advance'
+ *
+ * Account for the time since the last call and return the number of
+ * steps to run now.
+ */
+int sim_clock_advance(sim_clock_t *clock);
+
+/*
+ * 'sim_clock_alpha'
+ *
+ * How far the current time is past the last step, from 0 up to (but
+ * not including) FIX_ONE.
+ */
+fix_t sim_clock_alpha(const sim_clock_t *clock);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+/*
+ * Headless shot solver.
+ *
+ * A candidate is one of the shots the rotors can produce: one of the
+ * 1024 MOVE_ROTOR directions at one of the 5 strengths. Each candidate
+ * is simulated to rest on the real physics (balls.h), together with a
+ * few randomized perturbations of it (the rotor is never read exactly
+ * the same twice), and scored by where the balls end up: in the hole,
+ * far from it, or in the water.
+ *
+ * Work is done in ranges of candidates with solver_eval, which only
+ * depends on its arguments, so ranges can be spread over threads on
+ * the host or over frames on the Pi and always give the same scores.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "balls.h"
+
+#define SOLVER_ANGLES 1024
+#define SOLVER_STRENGTHS 5
+#define SOLVER_CANDIDATES (SOLVER_ANGLES * SOLVER_STRENGTHS)
+
+/* Score of a ball that sank in water, worse than being anywhere on the field */
+#define SOLVER_WATER_PENALTY 1024
+
+typedef struct {
+    const course_t *course;
+    fix_t tee_x, tee_y;       // where every shot starts
+    bp_rect_t goal;           // distances are measured to its center
+    fix_t shot_speed;         // speed per strength level
+    int perturbations;        // extra randomized shots per candidate
+    unsigned int seed;        // picks the perturbations
+    int max_steps;            // a ball still rolling after this is scored where it is
+} solver_problem_t;
+
+/*
+ * Type: 'solver_worker_t'
+ *
+ * Scratch space for one thread of evaluation. A worker may not be
+ * shared, but any number can evaluate the same problem at once as long
+ * as each has its own course (the broadphase keeps per-query state).
+ */
+typedef struct {
+    int chunk;                // most candidates per solver_eval call
+    ball_batch_t batch;
+} solver_worker_t;
+
+/*
+ * 'solver_worker_init'
+ *
+ * Allocate a worker that evaluates up to `chunk` candidates at a time.
+ * Returns false if memory could not be allocated.
+ */
+bool solver_worker_init(solver_worker_t *worker, const solver_problem_t *problem, int chunk);
+
+/*
+ * 'solver_worker_free'
+ *
+ * Release the memory held by a worker.
+ */
+void solver_worker_free(solver_worker_t *worker);
+
+/*
+ * 'solver_eval'
+ *
+ * Simulate candidates first .. first + count - 1 (count at most the
+ * worker's chunk) and store their scores in scores[first ..]. Lower is
+ * better; 0 means every variant of the shot went in the hole.
+ */
+void solver_eval(const solver_problem_t *problem, solver_worker_t *worker, int first, int count, int scores[]);
+
+/*
+ * 'solver_best'
+ *
+ * Index of the lowest of `count` scores, the earliest one on ties.
+ */
+int solver_best(const int scores[], int count);
+
+/* Rotor position and strength of a candidate */
+static inline unsigned int solver_angle(int candidate)
+{
+    return candidate % SOLVER_ANGLES;
+}
+
+static inline int solver_strength(int candidate)
+{
+    return candidate / SOLVER_ANGLES + 1;
+}
+
+#endif
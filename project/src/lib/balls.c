@@ -0,0 +1,422 @@
+/*
+ * Batch ball physics: continuous collision against rectangles and the
+ * field's edges, terrain lookups and friction, for every ball at once.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "balls.h"
+#include "malloc.h"
+
+/*
+ * Earliest collision found while sweeping a ball along its path.
+ * Positions and displacements in the sweep are all Q16.16 pixels.
+ */
+typedef struct {
+    bool hit;
+    int t;        // time of impact as a fraction of the sweep, 16 bits (65536 = whole sweep)
+    int nx;       // normal to reflect about: a unit axis for faces, or
+    int ny;       // the vector from a corner to the ball center for corners
+} contact_t;
+
+static const int SWEEP_ONE = 1 << 16;
+static const int MAX_BOUNCES = 4;   // collisions resolved per step
+static const int SEAM_SLACK = FIX_ONE / 64;   // faces reach this far past a corner, as rounding can miss both at the seam
+
+bool balls_init(ball_batch_t *batch, int capacity) {
+    fix_t **fields[] = { &batch->x, &batch->y, &batch->vx, &batch->vy, &batch->dir_x, &batch->dir_y,
+                         &batch->speed, &batch->prev_x, &batch->prev_y };
+    bool ok = true;
+    for (int f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        *fields[f] = malloc(capacity * sizeof(fix_t));
+        ok = ok && *fields[f] != NULL;
+    }
+    batch->state = malloc(capacity);
+    ok = ok && batch->state != NULL;
+    batch->count = 0;
+    batch->capacity = ok ? capacity : 0;
+    return ok;
+}
+
+void balls_free(ball_batch_t *batch) {
+    free(batch->x);
+    free(batch->y);
+    free(batch->vx);
+    free(batch->vy);
+    free(batch->dir_x);
+    free(batch->dir_y);
+    free(batch->speed);
+    free(batch->prev_x);
+    free(batch->prev_y);
+    free(batch->state);
+    batch->count = batch->capacity = 0;
+}
+
+int balls_add(ball_batch_t *batch, fix_t x, fix_t y) {
+    if (batch->count >= batch->capacity) {
+        return -1;
+    }
+    int i = batch->count++;
+    balls_place(batch, i, x, y);
+    balls_launch(batch, i, 0, 0);
+    return i;
+}
+
+void balls_clear(ball_batch_t *batch) {
+    batch->count = 0;
+}
+
+void balls_place(ball_batch_t *batch, int i, fix_t x, fix_t y) {
+    batch->x[i] = batch->prev_x[i] = x;
+    batch->y[i] = batch->prev_y[i] = y;
+}
+
+void balls_launch(ball_batch_t *batch, int i, fix_t vx, fix_t vy) {
+    batch->vx[i] = vx;
+    batch->vy[i] = vy;
+    batch->speed[i] = fix_hypot(vx, vy);
+    batch->dir_x[i] = batch->speed[i] > 0 ? fix_div(vx, batch->speed[i]) : 0;
+    batch->dir_y[i] = batch->speed[i] > 0 ? fix_div(vy, batch->speed[i]) : 0;
+    batch->state[i] = batch->speed[i] > 0 ? BALL_ROLLING : BALL_RESTING;
+}
+
+static int abs_int(int val) {
+    return val < 0 ? -val : val;
+}
+
+/* Keep a contact if it happens earlier than the best one so far */
+static void record_contact(contact_t *best, int t, int nx, int ny) {
+    if (!best->hit || t < best->t) {
+        best->hit = true;
+        best->t = t;
+        best->nx = nx;
+        best->ny = ny;
+    }
+}
+
+/*
+ * Sweep the center (px, py) by (dx, dy) against the line x = face, spanning
+ * y_lo..y_hi, approached from the side the normal (side, 0) points to.
+ */
+static void sweep_x_face(contact_t *best, int px, int py, int dx, int dy, int face, int y_lo, int y_hi, int side) {
+    if (dx == 0 || (dx > 0) == (side > 0) || (px - face) * side < 0 || (px + dx - face) * side > 0) {
+        return;  // moving away, parallel, already past the face, or not reaching it
+    }
+    long long t = (long long)(face - px) * SWEEP_ONE / dx;
+    if (t > SWEEP_ONE) {
+        return;
+    }
+    int y = py + (int)((dy * t) >> 16);
+    if (y >= y_lo - SEAM_SLACK && y <= y_hi + SEAM_SLACK) {
+        record_contact(best, t, side, 0);
+    }
+}
+
+/* Same as sweep_x_face, for the line y = face spanning x_lo..x_hi */
+static void sweep_y_face(contact_t *best, int px, int py, int dx, int dy, int face, int x_lo, int x_hi, int side) {
+    if (dy == 0 || (dy > 0) == (side > 0) || (py - face) * side < 0 || (py + dy - face) * side > 0) {
+        return;
+    }
+    long long t = (long long)(face - py) * SWEEP_ONE / dy;
+    if (t > SWEEP_ONE) {
+        return;
+    }
+    int x = px + (int)((dx * t) >> 16);
+    if (x >= x_lo - SEAM_SLACK && x <= x_hi + SEAM_SLACK) {
+        record_contact(best, t, 0, side);
+    }
+}
+
+/*
+ * Sweep the ball against the rounded corner of the given radius around
+ * (cx, cy). Only contacts in the quadrant (qx, qy) away from the
+ * rectangle count; anywhere else a face is hit first.
+ */
+static void sweep_corner(contact_t *best, int px, int py, int dx, int dy, int cx, int cy, int qx, int qy, fix_t radius) {
+    if (abs_int(px - cx) > abs_int(dx) + radius || abs_int(py - cy) > abs_int(dy) + radius) {
+        return;  // corner out of reach this sweep
+    }
+    // solve the quadratic in Q24.8 so the products fit in 64 bits
+    long long fx = (px - cx) >> 8;
+    long long fy = (py - cy) >> 8;
+    long long ex = dx >> 8;
+    long long ey = dy >> 8;
+    long long r = radius >> 8;
+    long long a = ex * ex + ey * ey;
+    long long b = ex * fx + ey * fy;                  // half the linear term
+    long long c = fx * fx + fy * fy - r * r;
+    if (a == 0 || b >= 0 || c < 0) {
+        return;  // not moving, moving away, or already overlapping
+    }
+    long long disc = b * b - a * c;
+    if (disc < 0) {
+        return;
+    }
+    long long t = (-b - (long long)fix_isqrt(disc)) * SWEEP_ONE / a;
+    if (t > SWEEP_ONE) {
+        return;
+    }
+    int hx = px + (int)((dx * t) >> 16) - cx;
+    int hy = py + (int)((dy * t) >> 16) - cy;
+    if (hx * (long long)qx >= 0 && hy * (long long)qy >= 0) {
+        record_contact(best, t < 0 ? 0 : t, hx, hy);
+    }
+}
+
+/* Sweep the ball against a wall, i.e. the rectangle grown by the radius with rounded corners */
+static void sweep_wall(contact_t *best, int px, int py, int dx, int dy, const bp_rect_t *wall, fix_t radius) {
+    fix_t x0 = fix_from_int(wall->x);
+    fix_t y0 = fix_from_int(wall->y);
+    fix_t x1 = fix_from_int(wall->x + wall->width);
+    fix_t y1 = fix_from_int(wall->y + wall->height);
+    fix_t lo_x = dx < 0 ? px + dx : px, hi_x = dx < 0 ? px : px + dx;
+    fix_t lo_y = dy < 0 ? py + dy : py, hi_y = dy < 0 ? py : py + dy;
+    if (hi_x < x0 - radius || lo_x > x1 + radius || hi_y < y0 - radius || lo_y > y1 + radius) {
+        return;  // the swept box misses the grown rectangle
+    }
+    sweep_x_face(best, px, py, dx, dy, x0 - radius, y0, y1, -1);
+    sweep_x_face(best, px, py, dx, dy, x1 + radius, y0, y1, 1);
+    sweep_y_face(best, px, py, dx, dy, y0 - radius, x0, x1, -1);
+    sweep_y_face(best, px, py, dx, dy, y1 + radius, x0, x1, 1);
+    sweep_corner(best, px, py, dx, dy, x0, y0, -1, -1, radius);
+    sweep_corner(best, px, py, dx, dy, x1, y0, 1, -1, radius);
+    sweep_corner(best, px, py, dx, dy, x0, y1, -1, 1, radius);
+    sweep_corner(best, px, py, dx, dy, x1, y1, 1, 1, radius);
+}
+
+/*
+ * Sweep against the field's edges from the inside. A ball that starts
+ * beyond an edge and keeps moving outwards bounces immediately.
+ */
+static void sweep_edges(contact_t *best, int px, int py, int dx, int dy, const course_t *course) {
+    fix_t lo_x = fix_from_int(course->radius), hi_x = fix_from_int(course->width - course->radius);
+    fix_t lo_y = fix_from_int(course->radius), hi_y = fix_from_int(course->height - course->radius);
+    if (dx < 0 && px + dx < lo_x) {
+        record_contact(best, px <= lo_x ? 0 : (long long)(lo_x - px) * SWEEP_ONE / dx, 1, 0);
+    }
+    if (dx > 0 && px + dx > hi_x) {
+        record_contact(best, px >= hi_x ? 0 : (long long)(hi_x - px) * SWEEP_ONE / dx, -1, 0);
+    }
+    if (dy < 0 && py + dy < lo_y) {
+        record_contact(best, py <= lo_y ? 0 : (long long)(lo_y - py) * SWEEP_ONE / dy, 0, 1);
+    }
+    if (dy > 0 && py + dy > hi_y) {
+        record_contact(best, py >= hi_y ? 0 : (long long)(hi_y - py) * SWEEP_ONE / dy, 0, -1);
+    }
+}
+
+/* Reflect the vector (*vx, *vy) about a contact normal */
+static void mirror(fix_t *vx, fix_t *vy, int nx, int ny) {
+    if (ny == 0) {
+        *vx = -*vx;
+    }
+    else if (nx == 0) {
+        *vy = -*vy;
+    }
+    else {
+        // v - 2 (v.n) n / (n.n)
+        long long dot = (long long)*vx * nx + (long long)*vy * ny;
+        long long len2 = (long long)nx * nx + (long long)ny * ny;
+        *vx -= (fix_t)(2 * dot * nx / len2);
+        *vy -= (fix_t)(2 * dot * ny / len2);
+    }
+}
+
+/* Reflect the velocity of ball i, and its direction with it, about a contact normal */
+static void reflect(ball_batch_t *batch, int i, int nx, int ny) {
+    mirror(&batch->vx[i], &batch->vy[i], nx, ny);
+    mirror(&batch->dir_x[i], &batch->dir_y[i], nx, ny);
+}
+
+/* Pixel bounding box of ball i swept by (dx, dy), with a pixel to spare */
+static void swept_bounds(const ball_batch_t *batch, int i, int dx, int dy, int radius, bp_rect_t *box) {
+    box->x = fix_to_int(dx < 0 ? batch->x[i] + dx : batch->x[i]) - radius - 1;
+    box->y = fix_to_int(dy < 0 ? batch->y[i] + dy : batch->y[i]) - radius - 1;
+    box->width = fix_to_int(abs_int(dx)) + 2 * radius + 3;
+    box->height = fix_to_int(abs_int(dy)) + 2 * radius + 3;
+}
+
+/*
+ * Whether ball i can move by its whole velocity without touching
+ * anything: it ends up clear of the edges and no wall shares a grid
+ * cell with its path.
+ */
+static bool path_is_clear(const ball_batch_t *batch, int i, const course_t *course) {
+    fix_t x = batch->x[i] + batch->vx[i];
+    fix_t y = batch->y[i] + batch->vy[i];
+    fix_t r = fix_from_int(course->radius);
+    if (x < r || y < r || x > fix_from_int(course->width) - r || y > fix_from_int(course->height) - r) {
+        return false;
+    }
+    if (course->grid == NULL) {
+        return course->num_walls == 0;
+    }
+    bp_rect_t box;
+    swept_bounds(batch, i, batch->vx[i], batch->vy[i], course->radius, &box);
+    return !bp_any(course->grid, box.x, box.y, box.width, box.height);
+}
+
+/*
+ * Move ball i by its velocity, sweeping it as a circle: the earliest
+ * contact with any wall face, wall corner or edge is found, the ball
+ * moves there and reflects, and the rest of the step's motion continues
+ * from that point.
+ */
+static void sweep_ball(ball_batch_t *batch, int i, const course_t *course) {
+    fix_t radius = fix_from_int(course->radius);
+    int remaining = SWEEP_ONE;   // fraction of this step's motion still to do
+    for (int bounce = 0; bounce <= MAX_BOUNCES && remaining > 0; bounce++) {
+        int dx = (int)(((long long)batch->vx[i] * remaining) >> 16);
+        int dy = (int)(((long long)batch->vy[i] * remaining) >> 16);
+        contact_t contact = { false, 0, 0, 0 };
+        sweep_edges(&contact, batch->x[i], batch->y[i], dx, dy, course);
+        if (course->grid != NULL) {
+            // only walls in the cells the swept circle passes through can be hit
+            bp_rect_t box;
+            swept_bounds(batch, i, dx, dy, course->radius, &box);
+            const unsigned short *ids;
+            int n = bp_query(course->grid, box.x, box.y, box.width, box.height, &ids);
+            for (int k = 0; k < n; k++) {
+                sweep_wall(&contact, batch->x[i], batch->y[i], dx, dy, &course->walls[ids[k]], radius);
+            }
+        }
+        else {
+            for (int w = 0; w < course->num_walls; w++) {
+                sweep_wall(&contact, batch->x[i], batch->y[i], dx, dy, &course->walls[w], radius);
+            }
+        }
+        if (!contact.hit) {
+            batch->x[i] += dx;
+            batch->y[i] += dy;
+            break;
+        }
+        batch->x[i] += (int)(((long long)dx * contact.t) >> 16);
+        batch->y[i] += (int)(((long long)dy * contact.t) >> 16);
+        reflect(batch, i, contact.nx, contact.ny);
+        remaining = (int)(((long long)remaining * (SWEEP_ONE - contact.t)) >> 16);
+    }
+}
+
+void balls_push_out(ball_batch_t *batch, int i, const course_t *course) {
+    for (int w = 0; w < course->num_walls; w++) {
+        const bp_rect_t *wall = &course->walls[w];
+        fix_t x0 = fix_from_int(wall->x - course->radius);
+        fix_t y0 = fix_from_int(wall->y - course->radius);
+        fix_t x1 = fix_from_int(wall->x + wall->width + course->radius);
+        fix_t y1 = fix_from_int(wall->y + wall->height + course->radius);
+        fix_t x = batch->x[i], y = batch->y[i];
+        if (x <= x0 || x >= x1 || y <= y0 || y >= y1) {
+            continue;
+        }
+        fix_t left = x - x0, right = x1 - x;
+        fix_t top = y - y0, bottom = y1 - y;
+        fix_t nearest_x = left < right ? left : right;
+        fix_t nearest_y = top < bottom ? top : bottom;
+        if (nearest_x <= nearest_y) {
+            batch->x[i] = left < right ? x0 : x1;
+        }
+        else {
+            batch->y[i] = top < bottom ? y0 : y1;
+        }
+    }
+}
+
+/*
+ * Check the terrain under ball i. Water and the hole stop it there. A
+ * wall cell means it ran into a wall that only exists in the map, such
+ * as a curved or slanted one: it goes back to where the step started
+ * and reflects about that cell's normal. Rectangular walls are swept
+ * exactly and never get here.
+ */
+static void settle_on_terrain(ball_batch_t *batch, int i, const course_t *course) {
+    int x = fix_round(batch->x[i]);
+    int y = fix_round(batch->y[i]);
+    if (x < 0 || x >= course->width || y < 0 || y >= course->height) {
+        return;   // off the map is the field's edge, which the sweep handles
+    }
+    material_t m = mm_at(course->terrain, x, y);
+    if (m == MAT_WATER) {
+        batch->state[i] = BALL_IN_WATER;
+    }
+    else if (m == MAT_HOLE) {
+        batch->state[i] = BALL_IN_HOLE;
+    }
+    else if (m == MAT_WALL) {
+        int nx, ny;
+        mm_normal(course->terrain, x, y, &nx, &ny);
+        batch->x[i] = batch->prev_x[i];
+        batch->y[i] = batch->prev_y[i];
+        if ((long long)batch->vx[i] * nx + (long long)batch->vy[i] * ny >= 0) {
+            // no usable normal (e.g. a one-cell sliver): send it back the way it came
+            batch->vx[i] = -batch->vx[i];
+            batch->vy[i] = -batch->vy[i];
+            batch->dir_x[i] = -batch->dir_x[i];
+            batch->dir_y[i] = -batch->dir_y[i];
+        }
+        else {
+            reflect(batch, i, nx, ny);
+        }
+    }
+}
+
+/*
+ * Friction slows each ball along its direction of travel. A bounce turns
+ * the direction with the velocity, so the velocity is the direction
+ * scaled by the new speed and no ball needs a division. The helpers
+ * above reach the arrays through the batch, so only this pass, which
+ * calls none of them, promises the compiler they do not overlap.
+ */
+static void apply_friction(int n, fix_t friction, fix_t *restrict vx, fix_t *restrict vy,
+                           const fix_t *restrict dir_x, const fix_t *restrict dir_y,
+                           fix_t *restrict speed, unsigned char *restrict state) {
+    for (int i = 0; i < n; i++) {
+        if (state[i] != BALL_ROLLING) {
+            continue;
+        }
+        if (speed[i] <= friction) {
+            vx[i] = vy[i] = speed[i] = 0;
+            state[i] = BALL_RESTING;
+            continue;
+        }
+        speed[i] -= friction;
+        vx[i] = fix_mul(dir_x[i], speed[i]);
+        vy[i] = fix_mul(dir_y[i], speed[i]);
+    }
+}
+
+void balls_step(ball_batch_t *batch, const course_t *course) {
+    int n = batch->count;
+    fix_t *x = batch->x, *y = batch->y;
+    fix_t *vx = batch->vx, *vy = batch->vy;
+    unsigned char *state = batch->state;
+
+    for (int i = 0; i < n; i++) {
+        batch->prev_x[i] = x[i];
+        batch->prev_y[i] = y[i];
+    }
+
+    // motion: most balls are out in the open and just move
+    for (int i = 0; i < n; i++) {
+        if (state[i] != BALL_ROLLING) {
+            continue;
+        }
+        if (path_is_clear(batch, i, course)) {
+            x[i] += vx[i];
+            y[i] += vy[i];
+        }
+        else {
+            sweep_ball(batch, i, course);
+        }
+    }
+
+    if (course->terrain != NULL) {
+        for (int i = 0; i < n; i++) {
+            if (state[i] == BALL_ROLLING) {
+                settle_on_terrain(batch, i, course);
+            }
+        }
+    }
+
+    apply_friction(n, course->friction, batch->vx, batch->vy, batch->dir_x, batch->dir_y,
+                   batch->speed, batch->state);
+}
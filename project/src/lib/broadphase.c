@@ -0,0 +1,139 @@
+/*
+ * Uniform-grid broadphase, built once per level with a counting sort so
+ * that each cell's shape ids sit next to each other in memory.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "broadphase.h"
+#include "malloc.h"
+#include "strings.h"
+
+/* Range of cells [*lo, *hi] covered by pixels start .. start + len - 1 */
+static void cell_range(int start, int len, int shift, int cells, int *lo, int *hi) {
+    int end = start + (len > 0 ? len - 1 : 0);
+    *lo = start < 0 ? 0 : start >> shift;
+    *hi = end < 0 ? 0 : end >> shift;
+    if (*lo >= cells) *lo = cells - 1;
+    if (*hi >= cells) *hi = cells - 1;
+}
+
+/* Grow a buffer to hold at least `needed` elements, discarding its contents */
+static bool reserve(void **buf, int *capacity, int needed, int elem_size) {
+    if (*buf != NULL && *capacity >= needed) {
+        return true;
+    }
+    free(*buf);
+    *buf = malloc((needed > 0 ? needed : 1) * elem_size);
+    *capacity = *buf != NULL ? needed : 0;
+    return *buf != NULL;
+}
+
+bool bp_build(broadphase_t *bp, int width, int height, int cell_shift, const bp_rect_t rects[], int n) {
+    int cols = (width + (1 << cell_shift) - 1) >> cell_shift;
+    int rows = (height + (1 << cell_shift) - 1) >> cell_shift;
+    if (bp->cols != cols || bp->rows != rows) {
+        free(bp->cell_start);
+        bp->cell_start = malloc((cols * rows + 1) * sizeof(int));
+        if (bp->cell_start == NULL) {
+            bp->cols = bp->rows = 0;
+            return false;
+        }
+    }
+    bp->cell_shift = cell_shift;
+    bp->cols = cols;
+    bp->rows = rows;
+    bp->count = 0;
+
+    if (n > bp->shapes_capacity) {
+        free(bp->results);
+        free(bp->stamp);
+        bp->results = malloc(n * sizeof(unsigned short));
+        bp->stamp = malloc(n * sizeof(unsigned int));
+        bp->shapes_capacity = n;
+        if (bp->results == NULL || bp->stamp == NULL) {
+            bp->shapes_capacity = 0;
+            return false;
+        }
+    }
+    if (n > 0) {
+        memset(bp->stamp, 0, n * sizeof(unsigned int));
+    }
+    bp->query = 0;
+
+    // pass 1: count the shapes in each cell, offset by one
+    int *start = bp->cell_start;
+    memset(start, 0, (cols * rows + 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        int c0, c1, r0, r1;
+        cell_range(rects[i].x, rects[i].width, cell_shift, cols, &c0, &c1);
+        cell_range(rects[i].y, rects[i].height, cell_shift, rows, &r0, &r1);
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) {
+                start[r * cols + c + 1]++;
+            }
+        }
+    }
+    for (int cell = 0; cell < cols * rows; cell++) {
+        start[cell + 1] += start[cell];
+    }
+    if (!reserve((void **)&bp->ids, &bp->ids_capacity, start[cols * rows], sizeof(unsigned short))) {
+        return false;
+    }
+
+    // pass 2: drop each id into its cells, using start[] as write cursors
+    for (int i = 0; i < n; i++) {
+        int c0, c1, r0, r1;
+        cell_range(rects[i].x, rects[i].width, cell_shift, cols, &c0, &c1);
+        cell_range(rects[i].y, rects[i].height, cell_shift, rows, &r0, &r1);
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) {
+                bp->ids[start[r * cols + c]++] = i;
+            }
+        }
+    }
+    // every cursor now sits at the next cell's start; shift them back
+    for (int cell = cols * rows; cell > 0; cell--) {
+        start[cell] = start[cell - 1];
+    }
+    start[0] = 0;
+    bp->count = n;
+    return true;
+}
+
+void bp_free(broadphase_t *bp) {
+    free(bp->cell_start);
+    free(bp->ids);
+    free(bp->results);
+    free(bp->stamp);
+    memset(bp, 0, sizeof(*bp));
+}
+
+int bp_query(broadphase_t *bp, int x, int y, int w, int h, const unsigned short **ids) {
+    *ids = bp->results;
+    if (bp->count == 0) {
+        return 0;
+    }
+    if (++bp->query == 0) {
+        // stamps wrapped around; forget them all
+        memset(bp->stamp, 0, bp->count * sizeof(unsigned int));
+        bp->query = 1;
+    }
+    int c0, c1, r0, r1;
+    cell_range(x, w, bp->cell_shift, bp->cols, &c0, &c1);
+    cell_range(y, h, bp->cell_shift, bp->rows, &r0, &r1);
+    int found = 0;
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int cell = r * bp->cols + c;
+            for (int k = bp->cell_start[cell]; k < bp->cell_start[cell + 1]; k++) {
+                unsigned short id = bp->ids[k];
+                if (bp->stamp[id] != bp->query) {
+                    bp->stamp[id] = bp->query;
+                    bp->results[found++] = id;
+                }
+            }
+        }
+    }
+    return found;
+}
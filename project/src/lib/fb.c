@@ -6,10 +6,12 @@
  which drawing is done on one layer, the same as the display
  layer, or double-buffer mode, in which two layers are used
  (one for display and the other for drawing) that alternatively refreshes
- to create a smoother image transition.
+ to create a smoother image transition. Triple-buffer mode adds a third
+ layer so that a flip can still be in flight while the next frame is drawn.
  */
 
 #include "fb.h"
+#include "fb_extra.h"
 #include "assert.h"
 #include "mailbox.h"
 
@@ -28,19 +30,33 @@ typedef struct {
 
 static volatile fb_config_t fb __attribute__ ((aligned(16)));
 
+/* Which of the stacked screens in the virtual framebuffer does what */
+static struct {
+    unsigned int count;    // number of screens: 1, 2 or 3
+    unsigned int draw;     // screen handed out by fb_get_draw_buffer
+    unsigned int display;  // screen the GPU is scanning out
+    int pending;           // screen of a flip posted but not acknowledged, -1 if none
+} screens = { .pending = -1 };
+
+static void retire_pending_flip(void);
+
 void fb_init(unsigned int width, unsigned int height, unsigned int depth_in_bytes, fb_mode_t mode)
 {
+    retire_pending_flip(); // the GPU must be done with fb before we rewrite it
     fb.width = width;
     fb.virtual_width = width;
     fb.height = height;
-    if(mode == FB_SINGLEBUFFER) {
-        fb.virtual_height = height;
-    }
+    screens.count = 1;
     // if we are in double buffer mode, set virtual height to twice
     // the height to simultaneous store the display and draw buffers
     if(mode == FB_DOUBLEBUFFER) {
-        fb.virtual_height = 2 * height;
+        screens.count = 2;
     }
+    // triple buffering keeps a third screen for the flip in flight
+    if(mode == FB_TRIPLEBUFFER) {
+        screens.count = 3;
+    }
+    fb.virtual_height = screens.count * height;
     fb.bit_depth = depth_in_bytes * 8; // convert number of bytes to number of bits
     fb.x_offset = 0;
     fb.y_offset = 0;
@@ -51,11 +67,29 @@ void fb_init(unsigned int width, unsigned int height, unsigned int depth_in_byte
     fb.framebuffer = 0;
     fb.total_bytes = 0;
 
+    screens.display = 0;
+    screens.draw = screens.count > 1 ? 1 : 0;
+    screens.pending = -1;
+
     // Send address of fb struct to the GPU as message
     bool mailbox_success = mailbox_request(MAILBOX_FRAMEBUFFER, (unsigned int)&fb);
     assert(mailbox_success); // confirm successful config
 }
 
+/*
+ Waits for the GPU to acknowledge the flip posted by the previous swap,
+ if there is one, after which that screen is the one being displayed.
+ */
+static void retire_pending_flip(void)
+{
+    if(screens.pending >= 0) {
+        unsigned int response = mailbox_read(MAILBOX_FRAMEBUFFER);
+        assert(response == 0); // confirm success
+        screens.display = screens.pending;
+        screens.pending = -1;
+    }
+}
+
 /*
  Swaps the front framebuffer with the back framebuffer and
  vice versa, depending on which one is currently being displayed.
@@ -63,39 +97,47 @@ void fb_init(unsigned int width, unsigned int height, unsigned int depth_in_byte
  the contiguous memory where the first half is, or the second half
  of contiguous memory where the second half is.
  Sends a request to the mailbox to update the information change.
+ In triple-buffer mode the request is only posted; the CPU waits for
+ the GPU's answer at the next swap, and only if it has not arrived yet.
  */
 void fb_swap_buffer(void)
 {
-    if(fb.virtual_height == 2 * fb.height) { //only executes if in doouble buffer mode
-        // rotates to the back buffer
-        if(fb.y_offset == 0) {
-            fb.y_offset = fb.height;
-        }
-        // rotates to the front buffer
-        else {
-            fb.y_offset = 0;
-        }
+    if(screens.count == 2) { //only executes if in doouble buffer mode
+        // rotates the drawn buffer to the front and the front one to the back
+        screens.display = screens.draw;
+        screens.draw = 1 - screens.draw;
+        fb.y_offset = screens.display * fb.height;
         bool mailbox_success = mailbox_request(MAILBOX_FRAMEBUFFER, (unsigned int)&fb);
         assert(mailbox_success); // confirm success
     }
+    else if(screens.count == 3) {
+        // the GPU may write back into fb until it answers, so only touch
+        // the struct once the previous flip has been acknowledged
+        retire_pending_flip();
+        fb.y_offset = screens.draw * fb.height;
+        mailbox_write(MAILBOX_FRAMEBUFFER, (unsigned int)&fb);
+        screens.pending = screens.draw;
+        // next draw into the one screen neither shown nor about to be
+        screens.draw = 3 - screens.display - screens.pending;
+    }
 }
 
 /*
- Uses the initialized field y_offset to access
+ Uses the screen index being drawn to access
  a pointer to memory at the start of the current framebuffer
  the client can draw to.
  */
 void* fb_get_draw_buffer(void)
 {
-    if(fb.virtual_height == 2 * fb.height) { // if in doouble buffer mode
-        if(fb.y_offset == 0) { //if the buffer "on-screen" is in the top half
-            return (char*)fb.framebuffer + (fb.height * fb.pitch);
-        }
-        else {
-            return fb.framebuffer;
-        }
-    }
-    return fb.framebuffer; //default, single buffer return case
+    return (char*)fb.framebuffer + (screens.draw * fb.height * fb.pitch);
+}
+
+/*
+ Returns a pointer to the screen the GPU is currently scanning out.
+ */
+void *fb_get_display_buffer(void)
+{
+    return (char*)fb.framebuffer + (screens.display * fb.height * fb.pitch);
 }
 
 /*
@@ -130,4 +172,3 @@ unsigned int fb_get_pitch(void)
 {
     return fb.pitch;
 }
-
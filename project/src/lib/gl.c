@@ -7,14 +7,116 @@
  */
 
 #include "gl.h"
+#include "gl_extra.h"
 #include "font.h"
 #include "strings.h"
+#include "malloc.h"
 
 unsigned int gl_get_char_height(void);
 unsigned int gl_get_char_width(void);
 unsigned int per_row;
 static const int DEPTH = 4;
 
+#define DIRTY_MAX_BUFFERS 3
+#define DIRTY_MAX_RECTS 32
+
+typedef struct {
+    int x;
+    int y;
+    int w;
+    int h;
+} rect_t;
+
+/* Dirty regions still to be restored in one particular draw buffer */
+typedef struct {
+    void *buffer;    // draw buffer the list belongs to, NULL while unused
+    int count;
+    rect_t rects[DIRTY_MAX_RECTS];
+} dirty_list_t;
+
+static struct {
+    gl_repaint_fn_t repaint;
+    bool restoring;  // suppresses recording while the background is redrawn
+    dirty_list_t lists[DIRTY_MAX_BUFFERS];
+} dirty;
+
+/* Drawable area, as half-open bounds [x0, x1) x [y0, y1) */
+static struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} clip;
+
+#define CIRCLE_CACHE_SLOTS 4
+#define CIRCLE_CACHE_MAX_RADIUS 255
+
+/* Half-width of each row of a circle, indexed by distance from the center row */
+typedef struct {
+    bool valid;
+    int radius;
+    unsigned char half_width[CIRCLE_CACHE_MAX_RADIUS + 1];
+} circle_spans_t;
+
+static circle_spans_t circle_cache[CIRCLE_CACHE_SLOTS];
+static int circle_cache_next;  // slot to replace on a miss, round robin
+
+#define LINE_INTENSITY_BITS 4
+#define LINE_LEVELS (1 << LINE_INTENSITY_BITS)
+
+/* blend_table[level][v] = v * level / (LINE_LEVELS - 1), filled by gl_init */
+static unsigned char blend_table[LINE_LEVELS][256];
+
+#define ATLAS_FIRST_CHAR ' '
+#define ATLAS_LAST_CHAR '~'
+
+/*
+ Every printable glyph pre-expanded into one bitmask per row, bit i set
+ when column i is lit. Built once by gl_init; NULL if the font is wider
+ than 32 pixels or memory ran out, in which case glyphs are unpacked
+ from the font on every draw as before.
+ */
+static unsigned int *glyph_atlas;
+
+static void *draw_target;  // off-screen image being drawn to, NULL for the framebuffer
+
+/*
+ Unpacks every printable glyph from the font once and packs each row
+ into a bitmask.
+ */
+static void build_glyph_atlas(void)
+{
+    int width = font_get_glyph_width();
+    int height = font_get_glyph_height();
+    if(width > 32) {
+        return;
+    }
+    int nglyphs = ATLAS_LAST_CHAR - ATLAS_FIRST_CHAR + 1;
+    unsigned char *buf = malloc(font_get_glyph_size());
+    glyph_atlas = malloc(nglyphs * height * sizeof(unsigned int));
+    if(buf == NULL || glyph_atlas == NULL) {
+        free(buf);
+        free(glyph_atlas);
+        glyph_atlas = NULL;
+        return;
+    }
+    for(int i = 0; i < nglyphs; i++) {
+        unsigned int *rows = glyph_atlas + i * height;
+        memset(rows, 0, height * sizeof(unsigned int));
+        if(!font_get_glyph(ATLAS_FIRST_CHAR + i, buf, font_get_glyph_size())) {
+            continue;
+        }
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                if(buf[y * width + x] == 0xff) {
+                    rows[y] |= 1u << x;
+                }
+            }
+        }
+    }
+    free(buf);
+}
+
 /*
 Initializes the graphical display with the parameters passed
  through the function call (width, height, and mode).
@@ -23,6 +125,201 @@ void gl_init(unsigned int width, unsigned int height, gl_mode_t mode)
 {
     fb_init(width, height, 4, mode);    // use 32-bit depth always for graphics library
     per_row = fb_get_pitch() / DEPTH; // length of each row in pixels (include pitch's padding);
+    gl_reset_clip();
+    memset(dirty.lists, 0, sizeof(dirty.lists)); // buffers may have moved
+    draw_target = NULL;
+    for(int level = 0; level < LINE_LEVELS; level++) {
+        for(int v = 0; v < 256; v++) {
+            blend_table[level][v] = v * level / (LINE_LEVELS - 1);
+        }
+    }
+    if(glyph_atlas == NULL) {
+        build_glyph_atlas();
+    }
+}
+
+/*
+ Redirects drawing into an off-screen image laid out like the framebuffer
+ (same pitch and height). Passing NULL draws to the framebuffer again.
+ Nothing drawn off-screen is recorded as dirty.
+ */
+void gl_set_draw_target(void *pixels)
+{
+    draw_target = pixels;
+}
+
+/*
+ Returns the image currently being drawn to.
+ */
+void *gl_get_draw_target(void)
+{
+    return draw_target != NULL ? draw_target : fb_get_draw_buffer();
+}
+
+/*
+ Copies n pixels from src to dst, eight words per iteration.
+ */
+static void copy_row(color_t *dst, const color_t *src, int n)
+{
+    while(n >= 8) {
+        dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = src[3];
+        dst[4] = src[4]; dst[5] = src[5]; dst[6] = src[6]; dst[7] = src[7];
+        dst += 8;
+        src += 8;
+        n -= 8;
+    }
+    while(n-- > 0) {
+        *dst++ = *src++;
+    }
+}
+
+/* Two pixels stored at once; may_alias since it is written over color_t buffers */
+typedef unsigned long long __attribute__((may_alias)) color_pair_t;
+
+/*
+ Sets n pixels starting at dst to c. Once dst is 8-byte aligned, pixels
+ are written in pairs as doubleword stores, eight pixels per iteration.
+ */
+static void fill_row(color_t *dst, int n, color_t c)
+{
+    if(n > 0 && ((unsigned int)dst & 4)) {
+        *dst++ = c;
+        n--;
+    }
+    color_pair_t pair = ((color_pair_t)c << 32) | c;
+    color_pair_t *wide = (color_pair_t *)dst;
+    while(n >= 8) {
+        wide[0] = pair; wide[1] = pair; wide[2] = pair; wide[3] = pair;
+        wide += 4;
+        n -= 8;
+    }
+    dst = (color_t *)wide;
+    while(n-- > 0) {
+        *dst++ = c;
+    }
+}
+
+/*
+ Builds a pattern whose pixel (x, y) is texels[(x + y * shift) mod period].
+ The texels are repeated into a strip one framebuffer row plus one period
+ long, so any span of a row is a single copy out of the strip starting at
+ that row's phase. Call after gl_init. Returns false if out of memory.
+ */
+bool gl_pattern_init(gl_pattern_t *pattern, const color_t texels[], int period, int shift)
+{
+    pattern->period = period;
+    pattern->shift = ((shift % period) + period) % period;
+    pattern->length = per_row + period;
+    pattern->strip = malloc(pattern->length * sizeof(color_t));
+    if(pattern->strip == NULL) {
+        return false;
+    }
+    for(int i = 0; i < pattern->length; i++) {
+        pattern->strip[i] = texels[i % period];
+    }
+    return true;
+}
+
+/*
+ Releases the memory held by a pattern.
+ */
+void gl_pattern_free(gl_pattern_t *pattern)
+{
+    free(pattern->strip);
+    pattern->strip = NULL;
+}
+
+/*
+ Fills the rectangle (x, y, w, h) with a pattern, clipped. Each row is
+ one block copy from the strip; the phase only needs a modulo for the
+ first row and then rotates by `shift` per row.
+ */
+void gl_draw_pattern_rect(int x, int y, int w, int h, const gl_pattern_t *pattern)
+{
+    if(pattern->strip == NULL || !gl_clip_rect(&x, &y, &w, &h)) {
+        return;
+    }
+    int period = pattern->period;
+    int phase = (x + y * pattern->shift) % period;
+    if(w > pattern->length - phase) {
+        w = pattern->length - phase; // strip was built for a narrower screen
+    }
+    color_t (*im)[per_row] = gl_get_draw_target();
+    for(int row = y; row < y + h; row++) {
+        copy_row(&im[row][x], pattern->strip + phase, w);
+        phase += pattern->shift;
+        if(phase >= period) {
+            phase -= period;
+        }
+    }
+}
+
+/*
+ Copies the rectangle (x, y, w, h) from an off-screen image laid out like
+ the framebuffer into the same place in the draw target, clipped.
+ Whole-width copies of an unpadded buffer are done as a single block.
+ */
+void gl_copy_rect(const void *src, int x, int y, int w, int h)
+{
+    if(!gl_clip_rect(&x, &y, &w, &h)) {
+        return;
+    }
+    const color_t (*from)[per_row] = src;
+    color_t (*im)[per_row] = gl_get_draw_target();
+    if(w == per_row) {
+        copy_row(im[y], from[y], w * h);
+        return;
+    }
+    for(int row = y; row < y + h; row++) {
+        copy_row(&im[row][x], &from[row][x], w);
+    }
+}
+
+/*
+ Restricts drawing to the given rectangle, intersected with the screen.
+ */
+void gl_set_clip(int x, int y, int w, int h)
+{
+    gl_reset_clip();
+    if(!gl_clip_rect(&x, &y, &w, &h)) {
+        w = 0;
+        h = 0;
+    }
+    clip.x0 = x;
+    clip.y0 = y;
+    clip.x1 = x + w;
+    clip.y1 = y + h;
+}
+
+/*
+ Makes the whole screen drawable.
+ */
+void gl_reset_clip(void)
+{
+    clip.x0 = 0;
+    clip.y0 = 0;
+    clip.x1 = fb_get_width();
+    clip.y1 = fb_get_height();
+}
+
+/*
+ Intersects the rectangle with the clip rectangle in place.
+ Returns false if the intersection is empty.
+ */
+bool gl_clip_rect(int *x, int *y, int *w, int *h)
+{
+    int x0 = *x > clip.x0 ? *x : clip.x0;
+    int y0 = *y > clip.y0 ? *y : clip.y0;
+    int x1 = *x + *w < clip.x1 ? *x + *w : clip.x1;
+    int y1 = *y + *h < clip.y1 ? *y + *h : clip.y1;
+    if(x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    *x = x0;
+    *y = y0;
+    *w = x1 - x0;
+    *h = y1 - y0;
+    return true;
 }
 
 /*
@@ -65,12 +362,8 @@ color_t gl_color(unsigned char r, unsigned char g, unsigned char b)
  */
 void gl_clear(color_t c)
 {
-    color_t (*im)[per_row] = fb_get_draw_buffer();
-    for(int y = 0; y < fb_get_height(); y++) {
-        for(int x = 0; x < per_row; x++) {
-            im[y][x] = c;
-        }
-    }
+    fill_row(gl_get_draw_target(), per_row * fb_get_height(), c); // rows are contiguous
+    gl_dirty_add(0, 0, fb_get_width(), fb_get_height()); // background is gone
 }
 
 /*
@@ -80,10 +373,10 @@ void gl_clear(color_t c)
  */
 void gl_draw_pixel(int x, int y, color_t c)
 {
-    if(x < 0 || x >= fb_get_width() || y < 0 || y >= fb_get_height()) {
+    if(x < clip.x0 || x >= clip.x1 || y < clip.y0 || y >= clip.y1) {
         return;
     }
-    color_t (*im)[per_row] = fb_get_draw_buffer();
+    color_t (*im)[per_row] = gl_get_draw_target();
     im[y][x] = c;
 }
 
@@ -96,7 +389,7 @@ color_t gl_read_pixel(int x, int y)
     if(x < 0 || x >= per_row || y < 0 || y >= fb_get_height()) {
         return 0;
     }
-    color_t (*im)[per_row] = fb_get_draw_buffer();
+    color_t (*im)[per_row] = gl_get_draw_target();
     return im[y][x];
 }
 
@@ -107,19 +400,141 @@ color_t gl_read_pixel(int x, int y)
  */
 void gl_draw_rect(int x, int y, int w, int h, color_t c)
 {
+    if(!gl_clip_rect(&x, &y, &w, &h)) {
+        return;
+    }
+    color_t (*im)[per_row] = gl_get_draw_target();
     for(int y_len = y; y_len < y + h; y_len++) {
-        for(int x_len = x; x_len < x + w; x_len++) {
-            gl_draw_pixel(x_len, y_len, c); //fills up the 2D space with color
+        fill_row(&im[y_len][x], w, c); //fills up the 2D space one row at a time
+    }
+}
+
+/*
+ Returns the cached half-widths of the circle of radius r, where row dy
+ covers columns -half_width[dy]..half_width[dy], i.e. the largest x with
+ x*x + dy*dy <= r*r. A miss fills the next slot round robin, skipping
+ the table `keep` that the caller is still using. Returns NULL if r is
+ too large to cache.
+ */
+static const unsigned char *circle_half_widths(int r, const unsigned char *keep)
+{
+    if(r > CIRCLE_CACHE_MAX_RADIUS) {
+        return NULL;
+    }
+    for(int i = 0; i < CIRCLE_CACHE_SLOTS; i++) {
+        if(circle_cache[i].valid && circle_cache[i].radius == r) {
+            return circle_cache[i].half_width;
         }
     }
+    circle_spans_t *slot = &circle_cache[circle_cache_next];
+    if(slot->half_width == keep) {
+        circle_cache_next = (circle_cache_next + 1) % CIRCLE_CACHE_SLOTS;
+        slot = &circle_cache[circle_cache_next];
+    }
+    circle_cache_next = (circle_cache_next + 1) % CIRCLE_CACHE_SLOTS;
+    int x = r;
+    for(int dy = 0; dy <= r; dy++) {
+        while(x * x + dy * dy > r * r) { // half-width only shrinks as dy grows
+            x--;
+        }
+        slot->half_width[dy] = x;
+    }
+    slot->radius = r;
+    slot->valid = true;
+    return slot->half_width;
+}
+
+/*
+ Fills one row of a ring: columns -outer..outer around cx, minus the
+ columns -inner..inner (inner < 0 leaves the row solid).
+ */
+static void draw_ring_row(int cx, int y, int outer, int inner, color_t c)
+{
+    if(inner < 0) {
+        gl_draw_span(cx - outer, y, 2 * outer + 1, c);
+        return;
+    }
+    gl_draw_span(cx - outer, y, outer - inner, c);
+    gl_draw_span(cx + inner + 1, y, outer - inner, c);
+}
+
+/*
+ Draws a ring row by row. Half-widths come from the per-radius table, or
+ for radii too large to cache, are walked incrementally as rows advance.
+ An inner radius below zero draws a filled circle.
+ */
+static void draw_ring(int x, int y, int r, int r_inner, color_t c)
+{
+    if(r < 0) {
+        return;
+    }
+    const unsigned char *outer_table = circle_half_widths(r, NULL);
+    const unsigned char *inner_table = r_inner >= 0 ? circle_half_widths(r_inner, outer_table) : NULL;
+    int outer = r;
+    int inner = r_inner;
+    for(int dy = 0; dy <= r; dy++) {
+        if(outer_table != NULL) {
+            outer = outer_table[dy];
+        }
+        else {
+            while(outer * outer + dy * dy > r * r) {
+                outer--;
+            }
+        }
+        if(dy > r_inner) {
+            inner = -1;
+        }
+        else if(inner_table != NULL) {
+            inner = inner_table[dy];
+        }
+        else {
+            while(inner * inner + dy * dy > r_inner * r_inner) {
+                inner--;
+            }
+        }
+        draw_ring_row(x, y + dy, outer, inner, c);
+        if(dy > 0) {
+            draw_ring_row(x, y - dy, outer, inner, c);
+        }
+    }
+}
+
+/*
+ Draws a filled circle of radius r centered at (x, y), one span per row.
+ */
+void gl_draw_circle(int x, int y, int r, color_t c)
+{
+    draw_ring(x, y, r, -1, c);
+}
+
+/*
+ Draws a ring of outer radius r and the given thickness centered at (x, y).
+ */
+void gl_draw_ring(int x, int y, int r, int thickness, color_t c)
+{
+    draw_ring(x, y, r, r - thickness, c);
+}
+
+/*
+ Draws a horizontal run of len pixels starting at (x, y), clipped once
+ up front and written with whole-row stores.
+ */
+void gl_draw_span(int x, int y, int len, color_t c)
+{
+    int h = 1;
+    if(!gl_clip_rect(&x, &y, &len, &h)) {
+        return;
+    }
+    color_t (*im)[per_row] = gl_get_draw_target();
+    fill_row(&im[y][x], len, c);
 }
 
 /*
 Code partially from Lab 6, CS 107e.
-Draws a character with the glyph font style given the
-upper-left corner's (x, y) coordinate and the color c.
+Draws a character by unpacking its glyph from the font. Only used when
+the glyph atlas could not be built.
  */
-void gl_draw_char(int x, int y, char ch, color_t c)
+static void draw_char_unpacked(int x, int y, char ch, color_t c)
 {
     unsigned char buf[font_get_glyph_size()];
     bool got_glyph = font_get_glyph(ch, buf, sizeof(buf));
@@ -137,6 +552,41 @@ void gl_draw_char(int x, int y, char ch, color_t c)
     }
 }
 
+/*
+Draws a character with the glyph font style given the
+upper-left corner's (x, y) coordinate and the color c, writing the lit
+bits of each pre-expanded atlas row straight into the draw target.
+ */
+void gl_draw_char(int x, int y, char ch, color_t c)
+{
+    if(glyph_atlas == NULL) {
+        draw_char_unpacked(x, y, ch, c);
+        return;
+    }
+    if(ch < ATLAS_FIRST_CHAR || ch > ATLAS_LAST_CHAR) {
+        return;
+    }
+    int width = gl_get_char_width();
+    int height = gl_get_char_height();
+    const unsigned int *rows = glyph_atlas + (ch - ATLAS_FIRST_CHAR) * height;
+
+    if(x < clip.x0 || x + width > clip.x1 || y < clip.y0 || y + height > clip.y1) {
+        for(int y_len = 0; y_len < height; y_len++) { // partly clipped, check each pixel
+            for(unsigned int mask = rows[y_len]; mask != 0; mask &= mask - 1) {
+                gl_draw_pixel(x + __builtin_ctz(mask), y + y_len, c);
+            }
+        }
+        return;
+    }
+    color_t (*im)[per_row] = gl_get_draw_target();
+    for(int y_len = 0; y_len < height; y_len++) {
+        color_t *dst = &im[y + y_len][x];
+        for(unsigned int mask = rows[y_len]; mask != 0; mask &= mask - 1) {
+            dst[__builtin_ctz(mask)] = c; // lowest set bit is the next lit column
+        }
+    }
+}
+
 /*
 Draws a string horizontally starting from the upper-left coordinate of the
  first character (x, y) with the color c.
@@ -144,9 +594,10 @@ Draws a string horizontally starting from the upper-left coordinate of the
  */
 void gl_draw_string(int x, int y, const char* str, color_t c)
 {
-    for (int i = 0; i < strlen(str); i++) {
-        gl_draw_char(x, y, str[i], c);
-        x += gl_get_char_width();
+    int width = gl_get_char_width();
+    for (; *str != '\0'; str++) {
+        gl_draw_char(x, y, *str, c);
+        x += width;
     }
 }
 
@@ -167,107 +618,363 @@ unsigned int gl_get_char_width(void)
 }
 
 /*
- Helper function which performs anti-aliasing; returns the color
- value after "dimming" the current color base on the pixel's error/distance
- from the "actual" y value determined by the slope.
- Parameters include the actual y value and hex color.
+ Blends color c over the pixel at (x, y) with coverage `level`, from 0
+ (leave the pixel alone) to LINE_LEVELS - 1 (replace it with c). Each
+ channel is a sum of two blend table lookups, so no multiplies are needed.
  */
-color_t get_opacity(color_t c, float num) {
-    float decimal_distance = num - (int)num;
-    
-    char *result = (char*)c; //accessing each BGRA field as byte values
+static void blend_pixel(int x, int y, color_t c, int level)
+{
+    if(level == LINE_LEVELS - 1) {
+        gl_draw_pixel(x, y, c);
+        return;
+    }
+    color_t under = gl_read_pixel(x, y);
+    const unsigned char *fg = blend_table[level];
+    const unsigned char *bg = blend_table[LINE_LEVELS - 1 - level];
+    unsigned int r = fg[(c >> 16) & 0xff] + bg[(under >> 16) & 0xff];
+    unsigned int g = fg[(c >> 8) & 0xff] + bg[(under >> 8) & 0xff];
+    unsigned int b = fg[c & 0xff] + bg[under & 0xff];
+    gl_draw_pixel(x, y, (0xff << 24) | (r << 16) | (g << 8) | b);
+}
 
-    if(decimal_distance <= 0.1) {
-        result[0] = (int)(result[0] * 0.9);
-        result[1] = (int)(result[1] * 0.9);
-        result[2] = (int)(result[2] * 0.9);
+/*
+ Draws an anti-aliased line from (x1, y1) to (x2, y2) using Wu Xiaolin's
+ algorithm in integer form. The line is walked along its major axis; a
+ 16-bit fixed-point error accumulator tracks the exact position on the
+ minor axis, stepping it whenever the accumulator wraps, and its top
+ bits split the coverage between the two pixels straddling the line.
+ Works in every octant; horizontal, vertical and diagonal lines need no
+ blending and are drawn directly.
+ */
+void gl_draw_line(int x1, int y1, int x2, int y2, color_t c) {
+    if(y1 > y2) { // always walk downwards
+        int tmp = y1; y1 = y2; y2 = tmp;
+        tmp = x1; x1 = x2; x2 = tmp;
     }
-    else if(decimal_distance <= 0.2) {
-        result[0] = (int)(result[0] * 0.8);
-        result[1] = (int)(result[1] * 0.8);
-        result[2] = (int)(result[2] * 0.8);
+    int dx = x2 - x1;
+    int dy = y2 - y1;
+    int x_dir = 1;
+    if(dx < 0) {
+        x_dir = -1;
+        dx = -dx;
     }
-    else if(decimal_distance <= 0.3) {
-        result[0] = (int)(result[0] * 0.7);
-        result[1] = (int)(result[1] * 0.7);
-        result[2] = (int)(result[2] * 0.7);
+
+    if(dy == 0) {
+        gl_draw_span(x1 < x2 ? x1 : x2, y1, dx + 1, c);
+        return;
     }
-    else if(decimal_distance <= 0.4) {
-        result[0] = (int)(result[0] * 0.6);
-        result[1] = (int)(result[1] * 0.6);
-        result[2] = (int)(result[2] * 0.6);
+    if(dx == 0 || dx == dy) {
+        for(int i = 0; i <= dy; i++) {
+            gl_draw_pixel(x1, y1 + i, c);
+            x1 += (dx == 0) ? 0 : x_dir;
+        }
+        return;
     }
-    else if(decimal_distance <= 0.5) {
-        result[0] = (int)(result[0] * 0.5);
-        result[1] = (int)(result[1] * 0.5);
-        result[2] = (int)(result[2] * 0.5);
+
+    gl_draw_pixel(x1, y1, c); // endpoints lie exactly on the line
+    gl_draw_pixel(x2, y2, c);
+    unsigned short error_acc = 0;
+    const int shift = 16 - LINE_INTENSITY_BITS;
+    if(dy > dx) { // y-major: step y every pixel, x when the error wraps
+        unsigned short error_adj = ((unsigned int)dx << 16) / dy;
+        while(--dy) {
+            unsigned short prev = error_acc;
+            error_acc += error_adj;
+            if(error_acc <= prev) {
+                x1 += x_dir;
+            }
+            y1++;
+            int level = error_acc >> shift;
+            blend_pixel(x1, y1, c, LINE_LEVELS - 1 - level);
+            blend_pixel(x1 + x_dir, y1, c, level);
+        }
     }
-    else if(decimal_distance <= 0.6) {
-        result[0] = (int)(result[0] * 0.4);
-        result[1] = (int)(result[1] * 0.4);
-        result[2] = (int)(result[2] * 0.4);
+    else { // x-major: step x every pixel, y when the error wraps
+        unsigned short error_adj = ((unsigned int)dy << 16) / dx;
+        while(--dx) {
+            unsigned short prev = error_acc;
+            error_acc += error_adj;
+            if(error_acc <= prev) {
+                y1++;
+            }
+            x1 += x_dir;
+            int level = error_acc >> shift;
+            blend_pixel(x1, y1, c, LINE_LEVELS - 1 - level);
+            blend_pixel(x1, y1 + 1, c, level);
+        }
     }
-    else if(decimal_distance <= 0.7) {
-        result[0] = (int)(result[0] * 0.3);
-        result[1] = (int)(result[1] * 0.3);
-        result[2] = (int)(result[2] * 0.3);
+}
+
+/*
+ One polygon edge as a half-space bound on x, stepped row by row. For a
+ row the edge allows x >= ceil(n / d) (a left edge) or x <= floor(n / d)
+ (a right edge), where n changes by a fixed amount per row. n / d is kept
+ as quotient and remainder so stepping needs no division.
+ */
+typedef struct {
+    int q;       // floor(n / d)
+    int r;       // n - q * d, in [0, d)
+    int d;       // |A| of the edge function, > 0
+    int step_q;  // floor(per-row change of n / d)
+    int step_r;  // remainder of the per-row change, in [0, d)
+    bool left;   // bounds x from below
+} edge_t;
+
+/*
+ Floor division with a non-negative remainder, for a positive divisor.
+ */
+static void floor_divmod(int n, int d, int *q, int *r)
+{
+    *q = n / d;
+    *r = n % d;
+    if(*r < 0) {
+        (*q)--;
+        *r += d;
     }
-    else if(decimal_distance <= 0.8) {
-        result[0] = (int)(result[0] * 0.2);
-        result[1] = (int)(result[1] * 0.2);
-        result[2] = (int)(result[2] * 0.2);
+}
+
+/*
+ Sets up the edge from (x0, y0) to (x1, y1) for rasterizing from row y.
+ The edge function E(x, y) = a*x + b*y + k is non-negative on the inside
+ once `sign` orients the polygon. Returns false for a horizontal edge,
+ which bounds rows rather than columns; for a convex polygon every row
+ between the top and bottom vertex is already on its inner side.
+ */
+static bool edge_init(edge_t *e, int x0, int y0, int x1, int y1, int sign, int y)
+{
+    int a = sign * (y0 - y1);
+    int b = sign * (x1 - x0);
+    int k = sign * (x0 * y1 - x1 * y0);
+    if(a == 0) {
+        return false;
     }
-    else if(decimal_distance <= 0.9) {
-        result[0] = (int)(result[0] * 0.1);
-        result[1] = (int)(result[1] * 0.1);
-        result[2] = (int)(result[2] * 0.1);
+    if(a > 0) { // a*x >= -(b*y + k)
+        e->left = true;
+        e->d = a;
+        floor_divmod(-(b * y + k), a, &e->q, &e->r);
+        floor_divmod(-b, a, &e->step_q, &e->step_r);
     }
-    else {
-        return GL_WHITE;
+    else {      // -a*x <= b*y + k
+        e->left = false;
+        e->d = -a;
+        floor_divmod(b * y + k, -a, &e->q, &e->r);
+        floor_divmod(b, -a, &e->step_q, &e->step_r);
     }
-    
-    return (color_t)result;
+    return true;
 }
 
 /*
- Draws an anti-aliased line from (x1, y1) to (x2, y2) or vice versa.
- Draws the line using the Wu Xiaolin algorithm, first calculating
- the exact slope between the two points, then drawing pixels in pairs, with
- the pixel's opacity/anti-alias color determined by its distance from the
- actual y-value (calculated from the slope) given the x value.
+ Fills a convex polygon with vertices (xs[i], ys[i]) in either winding
+ order. Every edge becomes a half-space; each row's span is the
+ intersection of the bounds from all edges, which are advanced
+ incrementally from row to row, and is clipped and drawn with
+ gl_draw_span. Pixels exactly on an edge are included.
  */
-void gl_draw_line(int x1, int y1, int x2, int y2, color_t c) {
-    float slope; //uses a float to keep track of a pixel's distance from slope
-    if(x1 - x2  == 0) {
-        slope = 0;
-    }
-    else {
-        slope = (float)(y1 - y2) / (float)(x1 - x2);
-    }
-    float cur_y;
-    if(x1 < x2) {
-        cur_y = y1;
-        for(int cur_x = x1; cur_x < x2; cur_x++) {
-            gl_draw_pixel(cur_x, (int)cur_y, get_opacity(c, cur_y));
-            gl_draw_pixel(cur_x, (int)cur_y - 1, get_opacity(c, cur_y));
-            cur_y += slope;
+void gl_fill_polygon(const int xs[], const int ys[], int n, color_t c)
+{
+    if(n < 3 || n > GL_POLYGON_MAX_VERTICES) {
+        return;
+    }
+    int area = 0; // twice the signed area, orients the edge functions
+    int y_min = ys[0];
+    int y_max = ys[0];
+    for(int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        area += xs[i] * ys[j] - xs[j] * ys[i];
+        y_min = ys[i] < y_min ? ys[i] : y_min;
+        y_max = ys[i] > y_max ? ys[i] : y_max;
+    }
+    if(area == 0) {
+        return;
+    }
+    y_min = y_min > clip.y0 ? y_min : clip.y0;
+    y_max = y_max < clip.y1 - 1 ? y_max : clip.y1 - 1;
+    if(y_min > y_max) {
+        return;
+    }
+
+    edge_t edges[GL_POLYGON_MAX_VERTICES];
+    int nedges = 0;
+    int sign = area > 0 ? 1 : -1;
+    for(int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        if(edge_init(&edges[nedges], xs[i], ys[i], xs[j], ys[j], sign, y_min)) {
+            nedges++;
         }
     }
-    else {
-        cur_y = y2;
-        for(int cur_x = x2; cur_x < x1; cur_x++) {
-            gl_draw_pixel(cur_x, (int)cur_y, get_opacity(c, cur_y));
-            gl_draw_pixel(cur_x, (int)cur_y - 1, get_opacity(c, cur_y));
-            cur_y += slope;
+
+    for(int y = y_min; y <= y_max; y++) {
+        int x_lo = clip.x0;
+        int x_hi = clip.x1 - 1;
+        for(int i = 0; i < nedges; i++) {
+            edge_t *e = &edges[i];
+            if(e->left) {
+                int bound = e->q + (e->r != 0); // ceil(n / d)
+                x_lo = bound > x_lo ? bound : x_lo;
+            }
+            else {
+                x_hi = e->q < x_hi ? e->q : x_hi;
+            }
+            e->q += e->step_q;
+            e->r += e->step_r;
+            if(e->r >= e->d) {
+                e->q++;
+                e->r -= e->d;
+            }
+        }
+        if(x_lo <= x_hi) {
+            gl_draw_span(x_lo, y, x_hi - x_lo + 1, c);
         }
     }
 }
 
 /*
- Draws the 3 lines which create a given triangle. Unfilled.
+ Draws a triangle filled with color c.
  */
 void gl_draw_triangle(int x1, int y1, int x2, int y2, int x3, int y3, color_t c) {
-    gl_draw_line(x1, y1, x2, y2, c);
-    gl_draw_line(x1, y1, x3, y3, c);
-    gl_draw_line(x2, y2, x3, y3, c);
+    int xs[] = {x1, x2, x3};
+    int ys[] = {y1, y2, y3};
+    gl_fill_polygon(xs, ys, 3, c);
+}
+
+/*
+ Returns the dirty list of the buffer currently being drawn to, claiming
+ a free list the first time a buffer is seen. A newly claimed buffer has
+ never been painted, so it starts out completely dirty.
+ */
+static dirty_list_t *current_dirty_list(void)
+{
+    void *buffer = fb_get_draw_buffer();
+    for(int i = 0; i < DIRTY_MAX_BUFFERS; i++) {
+        dirty_list_t *list = &dirty.lists[i];
+        if(list->buffer == buffer) {
+            return list;
+        }
+        if(list->buffer == NULL) {
+            list->buffer = buffer;
+            list->count = 1;
+            list->rects[0] = (rect_t){0, 0, fb_get_width(), fb_get_height()};
+            return list;
+        }
+    }
+    return &dirty.lists[0]; // more buffers than expected, share the first list
+}
+
+/*
+ Adds a rectangle to a dirty list. Rectangles that touch or overlap an
+ existing entry are merged into it; when the list is full, the rectangle
+ is merged into whichever entry grows the least.
+ */
+static void dirty_list_add(dirty_list_t *list, rect_t r)
+{
+    int best = -1;
+    int best_growth = 0;
+    for(int i = 0; i < list->count; i++) {
+        rect_t *cur = &list->rects[i];
+        int x0 = r.x < cur->x ? r.x : cur->x;
+        int y0 = r.y < cur->y ? r.y : cur->y;
+        int x1 = r.x + r.w > cur->x + cur->w ? r.x + r.w : cur->x + cur->w;
+        int y1 = r.y + r.h > cur->y + cur->h ? r.y + r.h : cur->y + cur->h;
+        bool touching = r.x <= cur->x + cur->w && cur->x <= r.x + r.w &&
+                        r.y <= cur->y + cur->h && cur->y <= r.y + r.h;
+        int growth = (x1 - x0) * (y1 - y0) - cur->w * cur->h;
+        if(touching || (list->count == DIRTY_MAX_RECTS && (best < 0 || growth < best_growth))) {
+            best = i;
+            best_growth = growth;
+            if(touching) {
+                break;
+            }
+        }
+    }
+    if(best < 0) {
+        list->rects[list->count++] = r;
+        return;
+    }
+    rect_t *cur = &list->rects[best];
+    int x0 = r.x < cur->x ? r.x : cur->x;
+    int y0 = r.y < cur->y ? r.y : cur->y;
+    int x1 = r.x + r.w > cur->x + cur->w ? r.x + r.w : cur->x + cur->w;
+    int y1 = r.y + r.h > cur->y + cur->h ? r.y + r.h : cur->y + cur->h;
+    *cur = (rect_t){x0, y0, x1 - x0, y1 - y0};
+}
+
+/*
+ Clips a rectangle to the screen (not the clip rectangle).
+ Returns false if it is entirely off-screen.
+ */
+static bool dirty_clip(int *x, int *y, int *w, int *h)
+{
+    if(*x < 0) {
+        *w += *x;
+        *x = 0;
+    }
+    if(*y < 0) {
+        *h += *y;
+        *y = 0;
+    }
+    if(*x + *w > (int)fb_get_width()) {
+        *w = fb_get_width() - *x;
+    }
+    if(*y + *h > (int)fb_get_height()) {
+        *h = fb_get_height() - *y;
+    }
+    return *w > 0 && *h > 0;
+}
+
+/*
+ Registers the background repaint function and marks every buffer dirty.
+ */
+void gl_dirty_init(gl_repaint_fn_t repaint)
+{
+    dirty.repaint = repaint;
+    dirty.restoring = false;
+    memset(dirty.lists, 0, sizeof(dirty.lists));
+}
+
+/*
+ Records a region of the current draw buffer that was drawn over.
+ */
+void gl_dirty_add(int x, int y, int w, int h)
+{
+    if(dirty.repaint == NULL || dirty.restoring || draw_target != NULL || !dirty_clip(&x, &y, &w, &h)) {
+        return;
+    }
+    dirty_list_add(current_dirty_list(), (rect_t){x, y, w, h});
+}
+
+/*
+ Records a region whose background changed; every buffer that has
+ already been painted needs it redrawn.
+ */
+void gl_dirty_invalidate(int x, int y, int w, int h)
+{
+    if(dirty.repaint == NULL || !dirty_clip(&x, &y, &w, &h)) {
+        return;
+    }
+    for(int i = 0; i < DIRTY_MAX_BUFFERS; i++) {
+        if(dirty.lists[i].buffer != NULL) {
+            dirty_list_add(&dirty.lists[i], (rect_t){x, y, w, h});
+        }
+    }
+}
+
+/*
+ Restores the background under every dirty region of the current draw
+ buffer, clipping the client's repaint function to each region in turn.
+ */
+void gl_dirty_restore(void)
+{
+    if(dirty.repaint == NULL) {
+        return;
+    }
+    dirty_list_t *list = current_dirty_list();
+    dirty.restoring = true;
+    for(int i = 0; i < list->count; i++) {
+        rect_t r = list->rects[i];
+        gl_set_clip(r.x, r.y, r.w, r.h);
+        dirty.repaint(r.x, r.y, r.w, r.h);
+    }
+    gl_reset_clip();
+    list->count = 0;
+    dirty.restoring = false;
 }
@@ -2,6 +2,7 @@
 #include "gpio_extra.h"
 #include "uart.h"
 #include "gl.h"
+#include "gl_extra.h"
 #include "fb.h"
 #include "font.h"
 #include "strings.h"
@@ -11,7 +12,17 @@
 #include "timer.h"
 #include "mcp3008.h"
 #include "bullet.h"
+#include "fixed.h"
+#include "broadphase.h"
+#include "material.h"
+#include "balls.h"
+#include "solver.h"
+#include "replay.h"
+#include "level.h"
+#include "levelgen.h"
+#include "assert.h"
 #include "golf.h"
+#include "prof.h"
 
 /* 
  * Boxin Zhang, Yiyang (Young) Chen, March 10, 2022
@@ -23,9 +34,9 @@
 #define MOVE_ROTOR 4
 
 /* Basic parameters: screen size, radius of golf */
-const int WIDTH_SCREEN = 640;
-const int HEIGHT_SCREEN = 512;
-const int RADIUS = 5;
+const int WIDTH_SCREEN = LEVELGEN_WIDTH;
+const int HEIGHT_SCREEN = LEVELGEN_HEIGHT;
+const int RADIUS = LEVELGEN_RADIUS;
 const color_t LAKE_BLUE = 0x4BB6EF;
 const color_t LIGHT_BLUE = 0xBFE1F4;
 const color_t GRASS = 0x567d46;
@@ -33,91 +44,162 @@ const color_t LIGHT_GREEN = 0x7ec850;
 const color_t LIGHT_GRASS = 0xB3D48E;
 const color_t FLOWER = 0xE36B89;
 
-/* Setup six lakes and three obstacles in golf game */
-static lake_t lakes[3];
-static obs_t obstacle[4];
-static ball_t ball;
-static goal_t goal;
+/*
+ * The level being played (see level.h). Generated levels, with 3 lakes
+ * and 4 walls, are written into generated_level; curated ones are
+ * played where they are linked, without being copied.
+ */
+static uint32_t generated_words[LEVEL_BYTES(LEVEL_MAX_SHAPES) / 4];
+static level_t *const generated_level = (level_t *)generated_words;
+static const level_t *current_level = (const level_t *)generated_words;
+static levelgen_t level_gen;
+
+/*
+ * Every level linked into the image (see level.h): the curated holes and
+ * the library pre-generated by the host level farm. The pack is walked
+ * once, so picking a level afterwards takes constant time.
+ */
+#define LIBRARY_MAX 256
+static const level_t *library[LIBRARY_MAX];
+static int library_size = -1;     // -1 until the pack has been walked
 
-/* Constants for dividing quadrants */
-const static int Q1 = 255;
-const static int Q2 = 511;
-const static int Q3 = 767;
-const static int Q4 = 1023;
-int num_cycles = 0;
+/* The game's ball is ball 0 of a one-ball batch, stepped against the level's course */
+static ball_batch_t balls;
+static const int BALL = 0;
+
+/* The level as the physics sees it: walls, their broadphase and the material map */
+static level_course_t field;
+static bool grid_stale = true;    // level layout changed since the course was built
+
+/*
+ * Predicted path shown while aiming: a dot every few physics steps until
+ * the ball stops or has bounced a few times. It is simulated on its own
+ * batch and only recomputed when the aim, the tee or the level changes.
+ */
+#define PREVIEW_DOTS 48
+static const int PREVIEW_SPACING = 3;     // physics steps between dots
+static const int PREVIEW_BOUNCES = 3;
+static ball_batch_t preview;
+static int preview_dot_x[PREVIEW_DOTS], preview_dot_y[PREVIEW_DOTS];
+static int preview_len = 0;
+static bool preview_valid = false;
+static unsigned int preview_pos;          // aim the path was computed for
+static int preview_strength;
+static fix_t preview_tee_x, preview_tee_y;
+
+static void update_preview(unsigned int pos, int strength);
+static void draw_preview(void);
+static void draw_aim(fix_t vx, fix_t vy, color_t c);
+
+/*
+ * Best shot from the ball's spot, for the hint and the computer player.
+ * Every rotor direction and strength is tried with a few perturbations
+ * (see solver.h), a chunk of candidates at a time so the search can be
+ * spread over frames. It restarts whenever the tee or the level changes.
+ */
+static const int HINT_CHUNK = 4;            // candidates per solver_eval call
+static const int HINT_PERTURBATIONS = 2;
+static const int HINT_MAX_STEPS = 300;      // 5 seconds of rolling
+static solver_problem_t hint_problem;
+static solver_worker_t hint_worker;
+static int hint_scores[SOLVER_CANDIDATES];
+static int hint_next = 0;                   // first candidate not yet scored
+static bool hint_valid = false;             // hint_problem matches the tee and level
+
+/* When set, nothing is drawn; the game still reads input and runs physics */
+static bool headless = false;
+
+/* Background bookkeeping for the dirty-rectangle renderer */
+static bool field_stale = true;   // level layout changed since last draw_field
+static int field_parity = -1;     // parity the buffers were last painted with
+static color_t *field_cache[2];   // pre-rendered field for each parity
+
+/* Terrain textures, indexed by parity */
+static gl_pattern_t grass_pattern[2];
+static gl_pattern_t water_pattern[2];
+static gl_pattern_t hedge_pattern[2];
+static bool patterns_ready = false;
+static bool patterns_failed = false;   // out of memory: plain rects instead, without trying again
+
+/* Shot speed per strength level, in px/frame; friction is in levelgen.h with the rest of the course */
+static const fix_t SHOT_SPEED = LEVELGEN_SHOT_SPEED;
 
 /* Initialize the ball at fixed position, velocity required */
 void ball_init(int angle, int start_position){
-    ball.x_pos = start_position;
-    ball.y_pos = HEIGHT_SCREEN;
-    ball.x_vel = 5;
-    ball.y_vel = ball.x_vel * angle;
+    if (balls.capacity == 0) {
+        bool ok = balls_init(&balls, 1);
+        assert(ok);
+        balls_add(&balls, 0, 0);
+    }
+    balls_place(&balls, BALL, fix_from_int(start_position), fix_from_int(HEIGHT_SCREEN));
+    balls_launch(&balls, BALL, fix_from_int(5), fix_from_int(5) * angle);
 }
 
-/* Initialize the lakes */
+/*
+ * Size the lakes; a new level starts here, with a seed from the level
+ * stream, so the old shapes are cleared away. The lakes are placed
+ * once the walls are.
+ */
 void lake_init(void) {     
-    lakes[0].width = rand() % 10 + 25;   // Make sure lake no thinner than 20, no larger than 30
-    lakes[0].height = rand() % 10 + 25;  
-    lakes[0].x_pos = rand() % (WIDTH_SCREEN - lakes[0].width);    // Make sure goal not clipped on either side
-    lakes[0].y_pos = rand() % (HEIGHT_SCREEN - lakes[0].height);
-    
-    while (1){
-        lakes[1].width = rand() % 10 + 25;
-        lakes[1].height = rand() % 10 + 25; 
-        lakes[1].x_pos = rand() % (WIDTH_SCREEN - lakes[1].width);
-        lakes[1].y_pos = rand() % (HEIGHT_SCREEN - lakes[1].height);
-        if (dist_squared(lakes[0].x_pos, lakes[0].y_pos, lakes[1].x_pos, lakes[1].y_pos) >= 45){
-            break;
-        }
-    }
-
-    while (1){
-        lakes[2].width = rand() % 10 + 25;
-        lakes[2].height = rand() % 10 + 25; 
-        lakes[2].x_pos = rand() % (WIDTH_SCREEN - lakes[2].width);
-        lakes[2].y_pos = rand() % (HEIGHT_SCREEN - lakes[2].height);
-        if (dist_squared(lakes[0].x_pos, lakes[0].y_pos, lakes[2].x_pos, lakes[2].y_pos) >= 45 &&
-            dist_squared(lakes[1].x_pos, lakes[1].y_pos, lakes[2].x_pos, lakes[2].y_pos) >= 45){
-            break;
-        }
-    }
+    field_stale = true;
+    grid_stale = true;
+    levelgen_lakes(&level_gen, generated_level, rng_next(rand_stream(RAND_LEVEL)));
+    current_level = generated_level;
 }
 
 void wall_init(void){
-    /* Two vertical obstacles, one horizontal obstacle */
-
-    obstacle[0].width = rand() % 5 + 35;   // Make sure obstacle no wider than 40, no shorter than 10
-    obstacle[0].height = rand() % 50 + 200;  // Make sure obstacle height no taller than 400, no shorter than 100
-    obstacle[0].x_start = rand() % 100 + 25;  // x between 25-115
-    obstacle[0].y_start = rand() % 50;        // y between 0-50
-
-
-    obstacle[1].width = rand() % 5 + 35;   // Make sure obstacle no wider than 40, no shorter than 10
-    obstacle[1].height = rand() % 50 + 200;  // Make sure obstacle height no taller than 400, no shorter than 100
-    obstacle[1].x_start = rand() % 100 + 115;  // x between 115-215
-    obstacle[1].y_start = rand() % 50 + 350;   // y between 350-400
+    field_stale = true;
+    grid_stale = true;
+    levelgen_walls(&level_gen, generated_level);
+}
 
+/* Initialize the goal as square at rand pos */
+void goal_init(void){        
+    field_stale = true;
+    grid_stale = true;
+    PROF_SCOPE("goal");
+    levelgen_goal(&level_gen, generated_level, &field);
+}
 
-    obstacle[2].width = rand() % 50 + 200;   // Make sure obstacle no wider than 40, no shorter than 10
-    obstacle[2].height = rand() % 5 + 35;  // Make sure obstacle height no taller than 400, no shorter than 100
-    obstacle[2].x_start = rand() % 100 + 300;  // x between 300-400
-    obstacle[2].y_start = rand() % 60 + 300;   // y between 300-360
+int level_par(void){
+    return current_level->par;
+}
 
-    obstacle[3].width = rand() % 5 + 35;   // Make sure obstacle no wider than 40, no shorter than 10
-    obstacle[3].height = rand() % 50 + 50;  // Make sure obstacle height no taller than 400, no shorter than 100
-    obstacle[3].x_start = rand() % 100 + 430;  
-    obstacle[3].y_start = rand() % 50 + 200;
+bool golf_load_level(const level_t *level, size_t bytes){
+    if (!level_valid(level, bytes)) {
+        return false;
+    }
+    field_stale = true;
+    grid_stale = true;
+    current_level = level;
+    ball_tee();
+    return true;
 }
 
-/* Initialize the goal as square at rand pos */
-void goal_init(void){        
-    goal.width = 30;
-    goal.height = 30;
-    goal.x_pos = rand() % 440 + 140;
-    goal.y_pos = rand() % 400 + 50;
+void golf_next_level(void){
+    if (library_size < 0) {
+        library_size = 0;
+        for (const level_t *level = level_first(__levels_start__, __levels_end__);
+             level != NULL && library_size < LIBRARY_MAX; level = level_next(level, __levels_end__)) {
+            library[library_size++] = level;
+        }
+    }
+    if (library_size == 0) {
+        // nothing linked in: generate one, as the game did before the library
+        lake_init();
+        wall_init();
+        goal_init();
+        ball_tee();
+        return;
+    }
+    const level_t *level = library[rand_below(library_size)];
+    golf_load_level(level, __levels_end__ - (const char *)level);
+}
 
-    // goal.x_pos = rand() % (WIDTH_SCREEN - 2 * goal.width);    // Make sure goal not clipped on either side
-    // goal.y_pos = rand() % (HEIGHT_SCREEN - 2 * goal.height);
+void ball_tee(void){
+    ball_init(0, 0);
+    balls_place(&balls, BALL, fix_from_int(current_level->tee_x), fix_from_int(current_level->tee_y));
+    balls_launch(&balls, BALL, 0, 0);
 }
 
 void draw_line_radius(int x1, int y1, int x2, int y2, int radius) {
@@ -125,11 +207,24 @@ void draw_line_radius(int x1, int y1, int x2, int y2, int radius) {
 }
 
 int get_ball_xvel(void) {
-    return ball.x_vel;
+    return fix_to_int(balls.vx[BALL]);
 }
 
 int get_ball_yvel(void) {
-    return ball.y_vel;
+    return fix_to_int(balls.vy[BALL]);
+}
+
+void get_ball_position(fix_t *x, fix_t *y) {
+    *x = balls.x[BALL];
+    *y = balls.y[BALL];
+}
+
+void golf_set_headless(bool enabled) {
+    headless = enabled;
+}
+
+bool ball_at_rest(void) {
+    return balls.state[BALL] == BALL_RESTING;
 }
 
 /*
@@ -137,77 +232,223 @@ int get_ball_yvel(void) {
    the billard ball is hit from 1 - 5; 
    */
 int get_strength(void) {
-    unsigned int level = mcp3008_read(AIM_ROTOR); // slope should range from 0-1023
+    unsigned int level = replay_mcp3008_read(AIM_ROTOR); // slope should range from 0-1023
     return level / 255 + 1; 
 }
 
 /*
    Permits users to use the rotor to move 360 degrees around their starting
-   position to permit full-motion shooting
+   position to permit full-motion shooting. Every one of the 1024 rotor
+   positions is its own direction: 0 shoots right, 256 down, 512 left
+   and 768 up.
    */
 void get_angle(void) {
-    unsigned int pos = mcp3008_read(MOVE_ROTOR); // slope should range from 0-1023
-    if (pos <= Q1) {
-        //enable up to 6 angles in each quadrant
-        ball.y_vel = pos / 42; 
-        ball.x_vel = (Q1 - pos) / 42;
+    unsigned int pos = replay_mcp3008_read(MOVE_ROTOR); // slope should range from 0-1023
+    int strength = get_strength();
+    fix_t speed = SHOT_SPEED * strength;
+    balls_launch(&balls, BALL, fix_mul(speed, fix_cos(pos)), fix_mul(speed, fix_sin(pos)));
+    if (headless) {
+        return;
     }
-    else if (pos > Q1 && pos <= Q2) {
-        ball.x_vel = -1 * ((pos - Q1) / 42);
-        ball.y_vel = (Q2 - pos) / 42; 
+    update_preview(pos, strength);
+    draw_preview();
+    draw_aim(balls.vx[BALL], balls.vy[BALL], GL_WHITE); //draws a line pointing in the direction of our ball ball
+}
+
+/* Draw a line from the ball two frames' travel along the velocity (vx, vy) */
+static void draw_aim(fix_t vx, fix_t vy, color_t c){
+    int x = fix_round(balls.x[BALL]);
+    int y = fix_round(balls.y[BALL]);
+    int x_end = fix_round(balls.x[BALL] + 2 * vx);
+    int y_end = fix_round(balls.y[BALL] + 2 * vy);
+    gl_draw_line(x, y, x_end, y_end, c);
+    // anti-aliasing can spill one pixel past the line's bounding box
+    gl_dirty_add((x < x_end ? x : x_end) - 1, (y < y_end ? y : y_end) - 1,
+                 abs_val(x_end - x) + 3, abs_val(y_end - y) + 3);
+}
+
+void draw_ball(void){
+    draw_ball_at(FIX_ONE);
+}
+
+void draw_ball_at(fix_t alpha){
+    if (headless) {
+        return;
     }
-    else if (pos > Q2 && pos <= Q3) {
-        ball.y_vel = -1 * ((pos - Q2) / 42);
-        ball.x_vel = -1 * ((Q3 - pos) / 42);
+    fix_t prev_x = balls.prev_x[BALL], prev_y = balls.prev_y[BALL];
+    int x = fix_round(prev_x + fix_mul(balls.x[BALL] - prev_x, alpha));
+    int y = fix_round(prev_y + fix_mul(balls.y[BALL] - prev_y, alpha));
+    gl_draw_circle(x, y, RADIUS, GL_WHITE);
+    gl_dirty_add(x - RADIUS, y - RADIUS, 2 * RADIUS + 1, 2 * RADIUS + 1);
+    prof_draw_hud();
+    gl_swap_buffer();
+}
+
+/* Rebuild the broadphase, material map and course after the level changed */
+static void refresh_level(void){
+    if (grid_stale) {
+        level_course_build(&field, current_level);
+        grid_stale = false;
+        preview_valid = false;
+        hint_valid = false;
     }
-    else if (pos > Q3 && pos <= Q4) {
-        ball.x_vel = (pos - Q3) / 42; 
-        ball.y_vel = -1 * ((Q4 - pos) / 42); 
+}
+
+/* Whether a step turned the velocity (vx, vy) into (nx, ny) by more than friction's rounding */
+static bool bounced(fix_t vx, fix_t vy, fix_t nx, fix_t ny){
+    long long dot = (long long)vx * nx + (long long)vy * ny;
+    long long cross = (long long)vx * ny - (long long)vy * nx;
+    if (cross < 0) {
+        cross = -cross;
     }
-    ball.x_vel *= get_strength();
-    ball.y_vel *= get_strength(); 
-    gl_draw_line(ball.x_pos, ball.y_pos, 2 * ball.x_vel + ball.x_pos, ball.y_pos + 2 * ball.y_vel, GL_WHITE); //draws a line pointing in the direction of our ball ball
+    return dot < 0 || cross > dot / 64;   // reversed, or turned by more than about a degree
 }
 
-void draw_ball(void){
-    gl_draw_circle(ball.x_pos, ball.y_pos, RADIUS, GL_WHITE);
-    gl_swap_buffer();
-    timer_delay_ms(3);
+/*
+ * Simulate the shot the player is aiming, from the ball's spot, with the
+ * same steps the game will run, and record where to draw the dots.
+ */
+static void update_preview(unsigned int pos, int strength){
+    refresh_level();
+    fix_t tee_x = balls.x[BALL], tee_y = balls.y[BALL];
+    if (preview_valid && pos == preview_pos && strength == preview_strength &&
+        tee_x == preview_tee_x && tee_y == preview_tee_y) {
+        return;
+    }
+    PROF_SCOPE("preview");
+    preview_len = 0;
+    if (preview.capacity == 0 && (!balls_init(&preview, 1) || balls_add(&preview, 0, 0) < 0)) {
+        return;   // out of memory: no preview
+    }
+    balls_place(&preview, 0, tee_x, tee_y);
+    balls_launch(&preview, 0, balls.vx[BALL], balls.vy[BALL]);
+    int bounces = 0;
+    for (int step = 1; preview_len < PREVIEW_DOTS && bounces < PREVIEW_BOUNCES; step++) {
+        fix_t vx = preview.vx[0], vy = preview.vy[0];
+        balls_push_out(&preview, 0, &field.course);
+        balls_step(&preview, &field.course);
+        if (preview.state[0] != BALL_ROLLING) {
+            break;
+        }
+        if (bounced(vx, vy, preview.vx[0], preview.vy[0])) {
+            bounces++;
+        }
+        if (step % PREVIEW_SPACING == 0) {
+            preview_dot_x[preview_len] = fix_round(preview.x[0]);
+            preview_dot_y[preview_len] = fix_round(preview.y[0]);
+            preview_len++;
+        }
+    }
+    preview_pos = pos;
+    preview_strength = strength;
+    preview_tee_x = tee_x;
+    preview_tee_y = tee_y;
+    preview_valid = true;
 }
 
-bool hit_lake(void){
-    for (int i = 0; i < 4; i++){
-        if (ball_within_rect(lakes[i].x_pos, lakes[i].y_pos, lakes[i].width, lakes[i].height)){
-            return true;
+static void draw_preview(void){
+    for (int i = 0; i < preview_len; i++) {
+        gl_draw_circle(preview_dot_x[i], preview_dot_y[i], 1, GL_WHITE);
+        gl_dirty_add(preview_dot_x[i] - 1, preview_dot_y[i] - 1, 3, 3);
+    }
+}
+
+/* Point the search at the ball's current spot, throwing away any scores so far */
+static void hint_restart(void){
+    hint_problem = (solver_problem_t){
+        .course = &field.course,
+        .tee_x = balls.x[BALL],
+        .tee_y = balls.y[BALL],
+        .goal = { current_level->goal.x, current_level->goal.y, current_level->goal.width, current_level->goal.height },
+        .shot_speed = SHOT_SPEED,
+        .perturbations = HINT_PERTURBATIONS,
+        .seed = rng_next(rand_stream(RAND_AI)),
+        .max_steps = HINT_MAX_STEPS,
+    };
+    hint_next = 0;
+    hint_valid = true;
+}
+
+bool hint_update(unsigned int budget_us){
+    refresh_level();
+    if (!hint_valid || balls.x[BALL] != hint_problem.tee_x || balls.y[BALL] != hint_problem.tee_y) {
+        hint_restart();
+    }
+    if (hint_worker.chunk == 0 && !solver_worker_init(&hint_worker, &hint_problem, HINT_CHUNK)) {
+        solver_worker_free(&hint_worker);
+        return false;   // out of memory: no hints
+    }
+    PROF_SCOPE("hint");
+    unsigned int start = timer_get_ticks();
+    while (hint_next < SOLVER_CANDIDATES && timer_get_ticks() - start < budget_us) {
+        int count = SOLVER_CANDIDATES - hint_next;
+        if (count > HINT_CHUNK) {
+            count = HINT_CHUNK;
         }
+        solver_eval(&hint_problem, &hint_worker, hint_next, count, hint_scores);
+        hint_next += count;
     }
-    return false;
+    return hint_next == SOLVER_CANDIDATES;
 }
 
-bool hit_goal(void){
-    if (ball_within_rect(goal.x_pos, goal.y_pos, goal.width, goal.height)){
-        return true;
+bool hint_best(unsigned int *pos, int *strength){
+    if (!hint_valid || hint_next < SOLVER_CANDIDATES ||
+        balls.x[BALL] != hint_problem.tee_x || balls.y[BALL] != hint_problem.tee_y) {
+        return false;
     }
-    return false;
+    int best = solver_best(hint_scores, SOLVER_CANDIDATES);
+    *pos = solver_angle(best);
+    *strength = solver_strength(best);
+    return true;
 }
 
-bool ball_within_rect(int x, int y, int w, int h){
-    if (ball.x_pos >= x && ball.x_pos <= x + w){
-        if (ball.y_pos >= y && ball.y_pos <= y + h){
+void draw_hint(void){
+    unsigned int pos;
+    int strength;
+    if (!headless && hint_best(&pos, &strength)) {
+        fix_t speed = SHOT_SPEED * strength;
+        draw_aim(fix_mul(speed, fix_cos(pos)), fix_mul(speed, fix_sin(pos)), GL_YELLOW);
+    }
+}
+
+bool take_best_shot(void){
+    unsigned int pos;
+    int strength;
+    if (!hint_best(&pos, &strength)) {
+        return false;
+    }
+    fix_t speed = SHOT_SPEED * strength;
+    balls_launch(&balls, BALL, fix_mul(speed, fix_cos(pos)), fix_mul(speed, fix_sin(pos)));
+    return true;
+}
+
+/* Without a material map (out of memory), test the rectangles directly */
+bool hit_lake(void){
+    refresh_level();
+    if (field.terrain_ready) {
+        return balls.state[BALL] == BALL_IN_WATER;
+    }
+    for (int i = 0; i < current_level->num_shapes; i++){
+        const level_shape_t *lake = &current_level->shapes[i];
+        if (lake->material == MAT_WATER && ball_within_rect(lake->x, lake->y, lake->width, lake->height)){
             return true;
         }
     }
     return false;
 }
 
-void gl_draw_circle(int x, int y, int r, color_t color){
-    for (int i = x - r; i <= x + r; i++){
-        for (int j = y - r; j <= y + r; j++){
-            if ((i - x) * (i - x) + (j - y) * (j - y) <= (r * r)){
-                gl_draw_pixel(i, j, color);
-            }
-        }
+bool hit_goal(void){
+    refresh_level();
+    if (field.terrain_ready) {
+        return balls.state[BALL] == BALL_IN_HOLE;
     }
+    const level_shape_t *goal = &current_level->goal;
+    return ball_within_rect(goal->x, goal->y, goal->width, goal->height);
+}
+
+bool ball_within_rect(int x, int y, int w, int h){
+    bp_rect_t rect = { x, y, w, h };
+    return bp_rect_contains(&rect, fix_round(balls.x[BALL]), fix_round(balls.y[BALL]));
 }
 
 void gl_draw_banner(int x, int y, int parity) {
@@ -220,178 +461,172 @@ void gl_draw_banner(int x, int y, int parity) {
     }
 }
 
-void gl_draw_water(int x, int y, int w, int h, int parity) {
-    for(int y_len = y; y_len < y + h; y_len++) {
-        for(int x_len = x; x_len < x + w; x_len++) {
-            if((x_len + y_len) % (5 + 3 * parity) == 0) {
-                gl_draw_pixel(x_len, y_len, LIGHT_BLUE); 
-            }
-            else {
-                gl_draw_pixel(x_len, y_len, LAKE_BLUE); 
-            }
+/* Build a diagonal-stripe pattern: accent wherever (x + y) % period == 0 */
+static bool stripe_pattern_init(gl_pattern_t *pattern, int period, color_t base, color_t accent) {
+    color_t texels[period];
+    texels[0] = accent;
+    for (int i = 1; i < period; i++) {
+        texels[i] = base;
+    }
+    return gl_pattern_init(pattern, texels, period, 1);
+}
+
+/*
+ * Build the textures for both parities, once gl_init has run. Returns
+ * false if they could not all be built, in which case none are kept.
+ */
+static bool patterns_init(void) {
+    if (patterns_ready || patterns_failed) {
+        return patterns_ready;
+    }
+    bool ok = true;
+    for (int parity = 0; parity < 2; parity++) {
+        ok = stripe_pattern_init(&grass_pattern[parity], 3 + 3 * parity, GRASS, LIGHT_GRASS) && ok;
+        ok = stripe_pattern_init(&water_pattern[parity], 5 + 3 * parity, LAKE_BLUE, LIGHT_BLUE) && ok;
+        ok = stripe_pattern_init(&hedge_pattern[parity], 7 + 2 * parity, GRASS, FLOWER) && ok;
+    }
+    if (!ok) {
+        for (int parity = 0; parity < 2; parity++) {
+            gl_pattern_free(&grass_pattern[parity]);
+            gl_pattern_free(&water_pattern[parity]);
+            gl_pattern_free(&hedge_pattern[parity]);
         }
     }
+    patterns_ready = ok;
+    patterns_failed = !ok;
+    return ok;
+}
+
+void gl_draw_water(int x, int y, int w, int h, int parity) {
+    if (patterns_init()) {
+        gl_draw_pattern_rect(x, y, w, h, &water_pattern[parity]);
+    }
+    else {
+        gl_draw_rect(x, y, w, h, LAKE_BLUE);
+    }
 }
 
 void gl_draw_lakes(int parity) {
-    for (int i = 0; i < 3; i++) {
-        gl_draw_water(lakes[i].x_pos, lakes[i].y_pos, lakes[i].width, lakes[i].height, parity);
+    for (int i = 0; i < current_level->num_shapes; i++) {
+        const level_shape_t *lake = &current_level->shapes[i];
+        if (lake->material == MAT_WATER) {
+            gl_draw_water(lake->x, lake->y, lake->width, lake->height, parity);
+        }
     }
 }
 
 void gl_draw_grass(int parity)
 {
-    color_t (*im)[fb_get_pitch() / 4] = fb_get_draw_buffer();
-    int per_row = fb_get_pitch() / 4;
-    for(int y = 0; y < HEIGHT_SCREEN; y++) {
-        for(int x = 0; x < per_row; x++) {
-            if((x + y) % (3 + 3 * parity) == 0) {
-                im[y][x] = LIGHT_GRASS;
-            }
-            else {
-                im[y][x] = GRASS;
-            }
-        }
+    if (patterns_init()) {
+        gl_draw_pattern_rect(0, 0, WIDTH_SCREEN, HEIGHT_SCREEN, &grass_pattern[parity]);
+    }
+    else {
+        gl_draw_rect(0, 0, WIDTH_SCREEN, HEIGHT_SCREEN, GRASS);
     }
 }
 
 void gl_draw_hedge(int x, int y, int w, int h, int parity) {
-    for(int y_len = y; y_len < y + h; y_len++) {
-        for(int x_len = x; x_len < x + w; x_len++) {
-            if((x_len + y_len) % (7 + 2 * parity) == 0) {
-                gl_draw_pixel(x_len, y_len, FLOWER); 
-            }
-            else {
-                gl_draw_pixel(x_len, y_len, GRASS); 
-            }
-        }
+    if (patterns_init()) {
+        gl_draw_pattern_rect(x, y, w, h, &hedge_pattern[parity]);
+    }
+    else {
+        gl_draw_rect(x, y, w, h, FLOWER);   // plain grass would hide the wall
     }
 }
 
+/* Push the ball out of any wall it overlaps (e.g. a tee placed inside one) */
 void hit_wall(void){
-    /* If the ball hits any of the array of 
-     * obstacles, then bounce back */
-    for (int i = 0; i < 4; i++){
-        if (ball_within_rect(obstacle[i].x_start, obstacle[i].y_start, obstacle[i].width, obstacle[i].height)){
-
-            /* Check previous moment, four possibilities: 
-             * 1. X out of bounds, Y inbounds
-             * 2. X inbounds, Y out of bounds
-             * 3. X out of bounds, Y out of bounds
-             *    3.1 Decide which one the ball would hit first
-             *    3.2 Act accordingly
-             */
-
-            int prev_y_pos = ball.y_pos - ball.y_vel;
-            int prev_x_pos = ball.x_pos - ball.x_vel;
-
-            /* Condition one: x out of bounds, y inbounds */
-            if (!x_inbounds(prev_x_pos, obstacle[i].x_start, obstacle[i].x_start + obstacle[i].width) && 
-                    y_inbounds(prev_y_pos, obstacle[i].y_start, obstacle[i].y_start + obstacle[i].height)){
-
-                ball.x_vel = -(ball.x_vel);
-            }
-
-            /* Condition two: x inbounds, y out of bounds */
-            else if (x_inbounds(prev_x_pos, obstacle[i].x_start, obstacle[i].x_start + obstacle[i].width) &&
-                    !y_inbounds(prev_y_pos, obstacle[i].y_start, obstacle[i].y_start + obstacle[i].height)){
-
-                ball.y_vel = -(ball.y_vel);
-            }
-
-            /* Condition three: x out of bounds, y out of bounds */
-            else if (!x_inbounds(prev_x_pos, obstacle[i].x_start, obstacle[i].x_start + obstacle[i].width) &&
-                    !y_inbounds(prev_y_pos, obstacle[i].y_start, obstacle[i].y_start + obstacle[i].height)){
-
-                /* Possibility 1: Lower left corner */
-                if (prev_x_pos < obstacle[i].x_start && prev_y_pos < obstacle[i].y_start){
-                    if (hit_boundary(prev_x_pos, prev_y_pos, obstacle[i].x_start, obstacle[i].y_start)){
-                        ball.x_vel = -(ball.x_vel);
-                    }
-                    else{
-                        ball.y_vel = -(ball.y_vel);
-                    }
-                }
-                /* Possibility 2: Upper left corner */
-                if (prev_x_pos < obstacle[i].x_start && prev_y_pos > obstacle[i].y_start + obstacle[i].height){
-                    if (hit_boundary(prev_x_pos, prev_y_pos, obstacle[i].x_start, obstacle[i].y_start + obstacle[i].height)){
-                        ball.x_vel = -(ball.x_vel);
-                    }
-                    else{
-                        ball.y_vel = -(ball.y_vel);
-                    }
-                }
-
-                /* Possibility 3: Lower right corner */
-                if (prev_x_pos > obstacle[i].x_start + obstacle[i].width && prev_y_pos < obstacle[i].y_start){
-                    if (hit_boundary(prev_x_pos, prev_y_pos, obstacle[i].x_start + obstacle[i].width, obstacle[i].y_start)){
-                        ball.x_vel = -(ball.x_vel);
-                    }
-                    else{
-                        ball.y_vel = -(ball.y_vel);
-                    }
-                }
-
-                /* Possibility 4: Upper right corner */
-                if (prev_x_pos > obstacle[i].x_start + obstacle[i].width && prev_y_pos > obstacle[i].y_start + obstacle[i].height){
-                    if (hit_boundary(prev_x_pos, prev_y_pos, obstacle[i].x_start + obstacle[i].width, obstacle[i].y_start + obstacle[i].height)){
-                        ball.x_vel = -(ball.x_vel);
-                    }
-                    else{
-                        ball.y_vel = -(ball.y_vel);
-                    }
-                }
-            }
-        }
-    }
+    refresh_level();
+    balls_push_out(&balls, BALL, &field.course);
 }
 
 void move_ball(void){
-    ball.x_pos += ball.x_vel;
-    ball.y_pos += ball.y_vel;
-    if (ball.x_pos < 0 || ball.x_pos > WIDTH_SCREEN){
-        ball.x_vel = -(ball.x_vel);
-        ball.x_pos += ball.x_vel;
-    }
-    else if (ball.y_pos < 0 || ball.y_pos > HEIGHT_SCREEN){
-        ball.y_vel = -(ball.y_vel);
-        ball.y_pos += ball.y_vel;
-    }
-    //friction
-    if (num_cycles == 5) {
-        if(ball.x_vel > 0) {
-            ball.x_vel -= 1;
+    refresh_level();
+    balls_step(&balls, &field.course);
+}
+
+void step_ball(void){
+    hit_wall();
+    move_ball();
+}
+
+/* Paint the whole field; only the clipped region is actually touched */
+static void paint_field(int parity){
+    gl_draw_rect(0, 0, WIDTH_SCREEN, HEIGHT_SCREEN, LIGHT_GREEN);
+    /* Draw out the obstacles and lakes in the level's order, then the goal */
+    for (int i = 0; i < current_level->num_shapes; i++) {
+        const level_shape_t *shape = &current_level->shapes[i];
+        if (shape->material == MAT_WALL) {
+            gl_draw_hedge(shape->x, shape->y, shape->width, shape->height, parity);
+        }
+        else if (shape->material == MAT_WATER) {
+            gl_draw_water(shape->x, shape->y, shape->width, shape->height, parity);
         }
-        else if(ball.x_vel < 0) {
-            ball.x_vel += 1;
+        else {
+            gl_draw_rect(shape->x, shape->y, shape->width, shape->height, shape->material == MAT_HOLE ? GL_CAYENNE : LIGHT_GREEN);
         }
-        if (ball.y_vel > 0) {
-            ball.y_vel -= 1;
+    }
+    const level_shape_t *goal = &current_level->goal;
+    gl_draw_rect(goal->x, goal->y, goal->width, goal->height, GL_CAYENNE);     // goal
+    gl_draw_banner(goal->x + (goal->width / 2), goal->y + (goal->height / 2), parity);
+}
+
+/* Render both parities of the current level into the off-screen caches */
+static void build_field_cache(void){
+    unsigned int start = timer_get_ticks();
+    for (int parity = 0; parity < 2; parity++) {
+        if (field_cache[parity] == NULL) {
+            field_cache[parity] = malloc(fb_get_pitch() * fb_get_height());
         }
-        else if (ball.y_vel < 0) {
-            ball.y_vel += 1;
+        if (field_cache[parity] == NULL) {
+            return;  // out of memory, repaint_field draws directly instead
         }
-        num_cycles = 0;
+        gl_set_draw_target(field_cache[parity]);
+        paint_field(parity);
+        gl_set_draw_target(NULL);
     }
-    num_cycles++;
+    printf("Field cache rebuilt in %d usecs\n", timer_get_ticks() - start);
 }
 
-void draw_field(int parity){
-    gl_clear(LIGHT_GREEN);
-    /* Draw out the obstacles and goal */
-    for (int i = 0; i < 4; i++) {
-        gl_draw_hedge(obstacle[i].x_start, obstacle[i].y_start, obstacle[i].width, obstacle[i].height, parity);
+/* Restore a dirty region of the draw buffer from the background */
+static void repaint_field(int x, int y, int w, int h){
+    if (field_cache[field_parity] != NULL) {
+        gl_copy_rect(field_cache[field_parity], x, y, w, h);
+    }
+    else {
+        paint_field(field_parity);
     }
-    gl_draw_lakes(parity);
-    gl_draw_rect(goal.x_pos, goal.y_pos, goal.width, goal.height, GL_CAYENNE);     // goal
-    gl_draw_banner(goal.x_pos + (goal.width / 2), goal.y_pos + (goal.height / 2), parity);
 }
 
-bool hit_boundary(int prev_x, int prev_y, int sqr_x, int sqr_y){
-    if (ball.y_vel * abs_val(prev_x - sqr_x) > ball.x_vel * abs_val(prev_y - sqr_y)){
-        return true;
+/* Mark everything that looks different between the two parities */
+static void invalidate_animation(void){
+    for (int i = 0; i < current_level->num_shapes; i++) {
+        const level_shape_t *shape = &current_level->shapes[i];
+        if (shape->material == MAT_WALL || shape->material == MAT_WATER) {
+            gl_dirty_invalidate(shape->x, shape->y, shape->width, shape->height);
+        }
     }
-    return false;
+    // banner pole and flag, with a pixel of anti-aliasing around them
+    const level_shape_t *goal = &current_level->goal;
+    int banner_x = goal->x + (goal->width / 2);
+    int banner_y = goal->y + (goal->height / 2);
+    gl_dirty_invalidate(banner_x - 1, banner_y - 51, 33, 53);
+}
+
+void draw_field(int parity){
+    if (headless) {
+        return;
+    }
+    if (field_stale) {
+        build_field_cache();
+        gl_dirty_init(repaint_field);  // repaint both buffers from scratch
+        field_stale = false;
+    }
+    else if (parity != field_parity) {
+        invalidate_animation();
+    }
+    field_parity = parity;
+    gl_dirty_restore();
 }
 
 int abs_val(int val){
@@ -0,0 +1,74 @@
+/*
+ * Grid-jittered shape placement (see layout.h).
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "layout.h"
+
+#define GRID_CELLS (LAYOUT_GRID * LAYOUT_GRID)
+
+void layout_init(layout_t *layout, int clearance, rng_t *rng) {
+    layout->clearance = clearance;
+    layout->rng = rng;
+    layout->count = 0;
+}
+
+void layout_remove(layout_t *layout, int kind) {
+    int kept = 0;
+    for (int i = 0; i < layout->count; i++) {
+        if (layout->kinds[i] != kind) {
+            layout->shapes[kept] = layout->shapes[i];
+            layout->kinds[kept] = layout->kinds[i];
+            kept++;
+        }
+    }
+    layout->count = kept;
+}
+
+bool layout_fits(const layout_t *layout, const bp_rect_t *rect) {
+    int gap = layout->clearance;
+    for (int i = 0; i < layout->count; i++) {
+        const bp_rect_t *other = &layout->shapes[i];
+        if (rect->x < other->x + other->width + gap && other->x < rect->x + rect->width + gap &&
+            rect->y < other->y + other->height + gap && other->y < rect->y + rect->height + gap) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool layout_add(layout_t *layout, const bp_rect_t *rect, int kind) {
+    if (layout->count == LAYOUT_MAX_SHAPES) {
+        return false;
+    }
+    layout->shapes[layout->count] = *rect;
+    layout->kinds[layout->count] = kind;
+    layout->count++;
+    return true;
+}
+
+/* Random offset in 0 .. n - 1 */
+static int jitter(const layout_t *layout, int n) {
+    return n > 1 ? rng_below(layout->rng, n) : 0;
+}
+
+bool layout_place(layout_t *layout, int w, int h, const bp_rect_t *corners, int kind, bp_rect_t *out) {
+    // an odd stride visits every one of the 64 cells once, from a random start
+    int start = jitter(layout, GRID_CELLS);
+    int stride = 2 * jitter(layout, GRID_CELLS / 2) + 1;
+    for (int k = 0; k < GRID_CELLS; k++) {
+        int cell = (start + k * stride) % GRID_CELLS;
+        int col = cell % LAYOUT_GRID, row = cell / LAYOUT_GRID;
+        int x0 = corners->x + corners->width * col / LAYOUT_GRID;
+        int x1 = corners->x + corners->width * (col + 1) / LAYOUT_GRID;
+        int y0 = corners->y + corners->height * row / LAYOUT_GRID;
+        int y1 = corners->y + corners->height * (row + 1) / LAYOUT_GRID;
+        bp_rect_t rect = { x0 + jitter(layout, x1 - x0), y0 + jitter(layout, y1 - y0), w, h };
+        if (layout_fits(layout, &rect)) {
+            *out = rect;
+            return layout_add(layout, &rect, kind);
+        }
+    }
+    return false;
+}
@@ -0,0 +1,65 @@
+/*
+ * Binary level records (see level.h).
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "level.h"
+
+void level_init(level_t *level, unsigned int seed) {
+    *level = (level_t){
+        .magic = LEVEL_MAGIC,
+        .version = LEVEL_VERSION,
+        .size = LEVEL_BYTES(0),
+        .seed = seed,
+        .goal = { .material = MAT_HOLE },
+        .par = -1,
+    };
+}
+
+bool level_add(level_t *level, int max_shapes, int x, int y, int w, int h, material_t m) {
+    if (level->num_shapes >= max_shapes || level->num_shapes == LEVEL_MAX_SHAPES) {
+        return false;
+    }
+    level->shapes[level->num_shapes++] = (level_shape_t){ x, y, w, h, m, 0 };
+    level->size = LEVEL_BYTES(level->num_shapes);
+    return true;
+}
+
+void level_remove(level_t *level, material_t m) {
+    int kept = 0;
+    for (int i = 0; i < level->num_shapes; i++) {
+        if (level->shapes[i].material != m) {
+            level->shapes[kept++] = level->shapes[i];
+        }
+    }
+    level->num_shapes = kept;
+    level->size = LEVEL_BYTES(kept);
+}
+
+bool level_valid(const level_t *level, size_t bytes) {
+    if (bytes < sizeof(level_t) || ((uintptr_t)level & 3) != 0) {
+        return false;
+    }
+    if (level->magic != LEVEL_MAGIC || level->version != LEVEL_VERSION ||
+        level->size % 4 != 0 || level->size > bytes ||
+        level->size < LEVEL_BYTES(level->num_shapes)) {
+        return false;
+    }
+    // the material map holds 2 bits a cell, so anything else would be cut short
+    for (int i = 0; i < level->num_shapes; i++) {
+        if (level->shapes[i].material > MAT_HOLE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const level_t *level_first(const void *start, const void *end) {
+    const level_t *level = start;
+    return level_valid(level, (const char *)end - (const char *)start) ? level : NULL;
+}
+
+const level_t *level_next(const level_t *level, const void *end) {
+    return level_first((const char *)level + level->size, end);
+}
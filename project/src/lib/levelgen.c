@@ -0,0 +1,257 @@
+/*
+ * Level generation and course building (see levelgen.h).
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "levelgen.h"
+
+/*
+ * Where the lakes, walls and goal go. Every shape keeps LAYOUT_CLEARANCE
+ * from the others and from the tee, and placement takes bounded time
+ * (see layout.h); a hazard that fits nowhere is left out of the level.
+ */
+enum { SHAPE_TEE, SHAPE_LAKE, SHAPE_WALL, SHAPE_GOAL };
+static const int LAYOUT_CLEARANCE = 12;                  // room for the ball to pass between two shapes
+static const bp_rect_t TEE_AREA = { 0, LEVELGEN_HEIGHT - 40, 40, 40 };     // corner around the tee
+static const bp_rect_t GOAL_CORNERS = { 140, 50, 440, 400 };
+static const int GOAL_SIZE = 30;
+
+/*
+ * Every new goal is checked to be reachable from the tee in a player's
+ * shots (see reach.h) and moved if it is not. A layout whose goal stays
+ * out of reach after GOAL_REPAIRS moves is thrown away for a new one.
+ * All the checks of a level share the generator's budget of ball steps.
+ */
+#define REACH_ANGLES 32
+#define REACH_MAX_STEPS 300
+static const int GOAL_REPAIRS = 8;
+static const int LAYOUT_ATTEMPTS = 8;
+
+/* Range of the corner and size of each wall; walls may run off the screen's edge */
+typedef struct {
+    bp_rect_t corners;
+    int min_width, width_range;
+    int min_height, height_range;
+} wall_template_t;
+
+static const wall_template_t WALL_TEMPLATES[] = {
+    { { 25, 0, 100, 50 }, 35, 5, 200, 50 },      // tall wall hanging from the top
+    { { 115, 350, 100, 50 }, 35, 5, 200, 50 },   // tall wall rising from the bottom
+    { { 300, 300, 100, 60 }, 200, 50, 35, 5 },   // long horizontal wall
+    { { 430, 150, 100, 50 }, 35, 5, 50, 50 },    // short post on the right, above the long wall
+};
+
+/* Walls are bucketed into 32 px cells, the terrain into 4 px ones */
+static const int GRID_CELL_SHIFT = 5;
+/*
+ * Half a terrain cell must stay below the ball's radius, so a ball kept
+ * clear of a wall by the sweep never lands on one of that wall's cells.
+ */
+static const int TERRAIN_CELL_SHIFT = 2;
+
+/* Rasterize the level in the order it is painted: shapes, then the goal */
+static bool build_terrain(material_map_t *terrain, const level_t *level){
+    if (!mm_init(terrain, LEVELGEN_WIDTH, LEVELGEN_HEIGHT, TERRAIN_CELL_SHIFT)) {
+        return false;
+    }
+    for (int i = 0; i < level->num_shapes; i++) {
+        const level_shape_t *shape = &level->shapes[i];
+        mm_fill_rect(terrain, shape->x, shape->y, shape->width, shape->height, shape->material);
+    }
+    const level_shape_t *goal = &level->goal;
+    mm_fill_rect(terrain, goal->x, goal->y, goal->width, goal->height, MAT_HOLE);
+    mm_finish(terrain);
+    return true;
+}
+
+bool level_course_build(level_course_t *field, const level_t *level){
+    int num_walls = 0;
+    for (int i = 0; i < level->num_shapes; i++) {
+        const level_shape_t *wall = &level->shapes[i];
+        if (wall->material == MAT_WALL) {
+            field->walls[num_walls++] = (bp_rect_t){ wall->x, wall->y, wall->width, wall->height };
+        }
+    }
+    field->grid_ready = bp_build(&field->grid, LEVELGEN_WIDTH, LEVELGEN_HEIGHT, GRID_CELL_SHIFT, field->walls, num_walls);
+    field->terrain_ready = build_terrain(&field->terrain, level);
+    field->course = (course_t){
+        .width = LEVELGEN_WIDTH,
+        .height = LEVELGEN_HEIGHT,
+        .radius = LEVELGEN_RADIUS,
+        .friction = LEVELGEN_FRICTION,
+        .walls = field->walls,
+        .num_walls = num_walls,
+        .grid = field->grid_ready ? &field->grid : NULL,
+        .terrain = field->terrain_ready ? &field->terrain : NULL,
+    };
+    return field->grid_ready && field->terrain_ready;
+}
+
+void level_course_free(level_course_t *field){
+    bp_free(&field->grid);
+    mm_free(&field->terrain);
+    field->grid_ready = false;
+    field->terrain_ready = false;
+}
+
+/* Take out the shapes of one kind, to place them again around the rest */
+static void clear_shapes(levelgen_t *gen, int kind){
+    if (!gen->layout_ready) {
+        layout_init(&gen->layout, LAYOUT_CLEARANCE, &gen->rng);
+        layout_add(&gen->layout, &TEE_AREA, SHAPE_TEE);
+        gen->layout_ready = true;
+    }
+    layout_remove(&gen->layout, kind);
+}
+
+/* Place a w x h shape with its corner in `corners`, or report that it fits nowhere */
+static bool place_shape(levelgen_t *gen, int w, int h, bp_rect_t corners, int kind, bp_rect_t *out){
+    return layout_place(&gen->layout, w, h, &corners, kind, out);
+}
+
+/* Place the lakes drawn by levelgen_lakes around the other shapes, leaving out any that do not fit */
+static void place_lakes(levelgen_t *gen, level_t *level){
+    for (int i = 0; i < gen->lakes_pending; i++) {
+        int w = gen->lake_widths[i], h = gen->lake_heights[i];
+        bp_rect_t corners = { 0, 0, LEVELGEN_WIDTH - w, LEVELGEN_HEIGHT - h };   // Make sure lake not clipped on either side
+        bp_rect_t r;
+        if (place_shape(gen, w, h, corners, SHAPE_LAKE, &r)) {
+            level_add(level, LEVEL_MAX_SHAPES, r.x, r.y, r.width, r.height, MAT_WATER);
+        }
+    }
+    gen->lakes_pending = 0;
+}
+
+/*
+ * A new level starts here, so the old shapes are cleared away. Only the
+ * lakes' sizes are drawn: walls have the narrowest ranges, so they go
+ * down first and the lakes are placed around them.
+ */
+void levelgen_lakes(levelgen_t *gen, level_t *level, unsigned int seed){
+    rng_seed(&gen->rng, seed);
+    level_init(level, seed);
+    level->tee_x = 0;
+    level->tee_y = LEVELGEN_HEIGHT;
+    clear_shapes(gen, SHAPE_LAKE);
+    clear_shapes(gen, SHAPE_WALL);
+    clear_shapes(gen, SHAPE_GOAL);
+    for (int i = 0; i < LEVELGEN_LAKES; i++) {
+        gen->lake_widths[i] = rng_below(&gen->rng, 10) + 25;   // Make sure lake no thinner than 25, no larger than 34
+        gen->lake_heights[i] = rng_below(&gen->rng, 10) + 25;
+    }
+    gen->lakes_pending = LEVELGEN_LAKES;
+}
+
+void levelgen_walls(levelgen_t *gen, level_t *level){
+    clear_shapes(gen, SHAPE_WALL);
+    level_remove(level, MAT_WALL);
+    for (int i = 0; i < sizeof(WALL_TEMPLATES) / sizeof(WALL_TEMPLATES[0]); i++) {
+        const wall_template_t *t = &WALL_TEMPLATES[i];
+        int w = rng_below(&gen->rng, t->width_range) + t->min_width;
+        int h = rng_below(&gen->rng, t->height_range) + t->min_height;
+        bp_rect_t r;
+        if (place_shape(gen, w, h, t->corners, SHAPE_WALL, &r)) {
+            level_add(level, LEVEL_MAX_SHAPES, r.x, r.y, r.width, r.height, MAT_WALL);
+        }
+    }
+    place_lakes(gen, level);
+}
+
+/*
+ * Search the shots from the tee for the level's goal and record the par.
+ * The search may take what is left of *budget, and what it spends is
+ * taken off; a negative budget lets it run to the end.
+ */
+static reach_result_t check_goal(levelgen_t *gen, level_t *level, level_course_t *field, int *budget){
+    level_course_build(field, level);
+    reach_problem_t problem = {
+        .course = &field->course,
+        .tee_x = fix_from_int(level->tee_x),
+        .tee_y = fix_from_int(level->tee_y),
+        .shot_speed = LEVELGEN_SHOT_SPEED,
+        .angles = REACH_ANGLES,
+        .max_shots = LEVELGEN_MAX_SHOTS,
+        .max_steps = REACH_MAX_STEPS,
+        .budget = *budget < 0 ? REACH_EXHAUSTIVE(LEVELGEN_WIDTH, LEVELGEN_HEIGHT, REACH_ANGLES, REACH_MAX_STEPS)
+                              : *budget,
+    };
+    if (!gen->reach_ready) {
+        gen->reach_ready = reach_init(&gen->reach, &problem);
+        if (!gen->reach_ready) {
+            reach_free(&gen->reach);
+            level->par = -1;
+            return REACH_YES;   // out of memory: no check
+        }
+    }
+    int shots;
+    reach_result_t result = reach_check(&gen->reach, &problem, &shots);
+    if (*budget >= 0) {
+        *budget -= gen->reach.spent;
+    }
+    level->par = result == REACH_YES ? shots : -1;
+    return result;
+}
+
+/* Place the goal, and move it while the search finds it out of reach */
+static reach_result_t place_goal(levelgen_t *gen, level_t *level, level_course_t *field, int *budget){
+    clear_shapes(gen, SHAPE_GOAL);
+    level_shape_t *goal = &level->goal;
+    bp_rect_t r;
+    if (!place_shape(gen, GOAL_SIZE, GOAL_SIZE, GOAL_CORNERS, SHAPE_GOAL, &r)) {
+        // crowded level: anywhere on the field will do, and failing that the goal may touch a hazard
+        bp_rect_t anywhere = { 0, 0, LEVELGEN_WIDTH - GOAL_SIZE, LEVELGEN_HEIGHT - GOAL_SIZE };
+        if (!place_shape(gen, GOAL_SIZE, GOAL_SIZE, anywhere, SHAPE_GOAL, &r)) {
+            r = (bp_rect_t){ GOAL_CORNERS.x, GOAL_CORNERS.y, GOAL_SIZE, GOAL_SIZE };
+        }
+    }
+    *goal = (level_shape_t){ r.x, r.y, r.width, r.height, MAT_HOLE, 0 };
+
+    reach_result_t result = check_goal(gen, level, field, budget);
+    for (int tries = 0; result == REACH_NO && tries < GOAL_REPAIRS; tries++) {
+        clear_shapes(gen, SHAPE_GOAL);
+        if (!place_shape(gen, GOAL_SIZE, GOAL_SIZE, GOAL_CORNERS, SHAPE_GOAL, &r)) {
+            layout_add(&gen->layout, &(bp_rect_t){ goal->x, goal->y, goal->width, goal->height }, SHAPE_GOAL);
+            break;
+        }
+        *goal = (level_shape_t){ r.x, r.y, r.width, r.height, MAT_HOLE, 0 };
+        result = check_goal(gen, level, field, budget);
+    }
+    return result;
+}
+
+void levelgen_goal(levelgen_t *gen, level_t *level, level_course_t *field){
+    place_lakes(gen, level);
+    int budget = gen->budget == 0 ? LEVELGEN_REACH_BUDGET : gen->budget;
+    for (int layouts = 1; ; layouts++) {
+        reach_result_t result = place_goal(gen, level, field, &budget);
+        if (result == REACH_YES) {
+            return;
+        }
+        if (result == REACH_UNKNOWN || layouts == LAYOUT_ATTEMPTS) {
+            break;
+        }
+        // the goal cannot be reached here: a new layout from the next seed of this one's stream
+        levelgen_lakes(gen, level, rng_next(&gen->rng));
+        levelgen_walls(gen, level);
+    }
+
+    // out of budget: drop the hazards, since a goal on an open course can always be reached
+    clear_shapes(gen, SHAPE_LAKE);
+    clear_shapes(gen, SHAPE_WALL);
+    level_remove(level, MAT_WATER);
+    level_remove(level, MAT_WALL);
+    level->par = -1;
+    level_course_build(field, level);
+}
+
+void levelgen_make(levelgen_t *gen, level_t *level, unsigned int seed, level_course_t *field){
+    levelgen_lakes(gen, level, seed);
+    levelgen_walls(gen, level);
+    levelgen_goal(gen, level, field);
+}
+
+void levelgen_free(levelgen_t *gen){
+    reach_free(&gen->reach);
+    gen->reach_ready = false;
+}
@@ -0,0 +1,172 @@
+/*
+ * Material map rasterizer. Shapes are sampled at cell centers once per
+ * level, so the per-frame cost is a shift, a multiply and a mask.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "material.h"
+#include "malloc.h"
+#include "strings.h"
+
+#define MAX_POLYGON_VERTICES 16
+
+bool mm_init(material_map_t *map, int width, int height, int cell_shift) {
+    int size = 1 << cell_shift;
+    int cols = (width + size - 1) >> cell_shift;
+    int rows = (height + size - 1) >> cell_shift;
+    int count = cols * rows;
+    if (count > map->capacity) {
+        free(map->cells);
+        free(map->normals);
+        map->cells = malloc((count + 3) / 4);
+        map->normals = malloc(count);
+        map->capacity = count;
+        if (map->cells == NULL || map->normals == NULL) {
+            map->capacity = 0;
+            map->cols = map->rows = 0;
+            return false;
+        }
+    }
+    map->cell_shift = cell_shift;
+    map->cols = cols;
+    map->rows = rows;
+    memset(map->cells, 0, (count + 3) / 4);   // MAT_GRASS
+    memset(map->normals, 0, count);
+    return true;
+}
+
+void mm_free(material_map_t *map) {
+    free(map->cells);
+    free(map->normals);
+    memset(map, 0, sizeof(*map));
+}
+
+static void set_cell(material_map_t *map, int col, int row, material_t m) {
+    int cell = row * map->cols + col;
+    int shift = (cell & 3) * 2;
+    map->cells[cell >> 2] = (map->cells[cell >> 2] & ~(3 << shift)) | (m << shift);
+}
+
+static material_t get_cell(const material_map_t *map, int col, int row) {
+    int cell = row * map->cols + col;
+    return (material_t)((map->cells[cell >> 2] >> ((cell & 3) * 2)) & 3);
+}
+
+/* Pixel coordinate of the center of cell i */
+static int cell_center(const material_map_t *map, int i) {
+    return (i << map->cell_shift) + ((1 << map->cell_shift) >> 1);
+}
+
+/* Cells [*lo, *hi] whose centers may fall within pixels lo_px .. hi_px */
+static void cell_span(int lo_px, int hi_px, int shift, int cells, int *lo, int *hi) {
+    *lo = lo_px < 0 ? 0 : lo_px >> shift;
+    *hi = hi_px < 0 ? -1 : hi_px >> shift;
+    if (*hi >= cells) *hi = cells - 1;
+}
+
+void mm_fill_rect(material_map_t *map, int x, int y, int w, int h, material_t m) {
+    int c0, c1, r0, r1;
+    cell_span(x, x + w - 1, map->cell_shift, map->cols, &c0, &c1);
+    cell_span(y, y + h - 1, map->cell_shift, map->rows, &r0, &r1);
+    for (int r = r0; r <= r1; r++) {
+        int py = cell_center(map, r);
+        if (py < y || py >= y + h) {
+            continue;
+        }
+        for (int c = c0; c <= c1; c++) {
+            int px = cell_center(map, c);
+            if (px >= x && px < x + w) {
+                set_cell(map, c, r, m);
+            }
+        }
+    }
+}
+
+void mm_fill_circle(material_map_t *map, int cx, int cy, int r, material_t m) {
+    int c0, c1, r0, r1;
+    cell_span(cx - r, cx + r, map->cell_shift, map->cols, &c0, &c1);
+    cell_span(cy - r, cy + r, map->cell_shift, map->rows, &r0, &r1);
+    for (int row = r0; row <= r1; row++) {
+        int dy = cell_center(map, row) - cy;
+        for (int col = c0; col <= c1; col++) {
+            int dx = cell_center(map, col) - cx;
+            if (dx * dx + dy * dy <= r * r) {
+                set_cell(map, col, row, m);
+            }
+        }
+    }
+}
+
+void mm_fill_polygon(material_map_t *map, const int xs[], const int ys[], int n, material_t m) {
+    if (n < 3 || n > MAX_POLYGON_VERTICES) {
+        return;
+    }
+    int x_min = xs[0], x_max = xs[0], y_min = ys[0], y_max = ys[0];
+    for (int i = 1; i < n; i++) {
+        if (xs[i] < x_min) x_min = xs[i];
+        if (xs[i] > x_max) x_max = xs[i];
+        if (ys[i] < y_min) y_min = ys[i];
+        if (ys[i] > y_max) y_max = ys[i];
+    }
+    int c0, c1, r0, r1;
+    cell_span(x_min, x_max, map->cell_shift, map->cols, &c0, &c1);
+    cell_span(y_min, y_max, map->cell_shift, map->rows, &r0, &r1);
+    for (int row = r0; row <= r1; row++) {
+        int py = cell_center(map, row);
+        for (int col = c0; col <= c1; col++) {
+            int px = cell_center(map, col);
+            // even-odd rule: count the edges crossed by a ray going right
+            bool inside = false;
+            for (int i = 0, j = n - 1; i < n; j = i++) {
+                if ((ys[i] > py) != (ys[j] > py)) {
+                    long long lhs = (long long)(px - xs[i]) * (ys[j] - ys[i]);
+                    long long rhs = (long long)(xs[j] - xs[i]) * (py - ys[i]);
+                    // px < x of the edge at py, with the sign of (ys[j] - ys[i]) folded in
+                    if ((ys[j] > ys[i]) ? lhs < rhs : lhs > rhs) {
+                        inside = !inside;
+                    }
+                }
+            }
+            if (inside) {
+                set_cell(map, col, row, m);
+            }
+        }
+    }
+}
+
+void mm_finish(material_map_t *map) {
+    for (int row = 0; row < map->rows; row++) {
+        for (int col = 0; col < map->cols; col++) {
+            material_t m = get_cell(map, col, row);
+            int nx = 0, ny = 0;
+            // sum the directions towards neighbours made of something else
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int c = col + dx, r = row + dy;
+                    if (c < 0 || r < 0 || c >= map->cols || r >= map->rows) {
+                        continue;   // the map edge is not a boundary of the region
+                    }
+                    if (get_cell(map, c, r) != m) {
+                        nx += dx;
+                        ny += dy;
+                    }
+                }
+            }
+            map->normals[row * map->cols + col] = (nx & 0xf) | ((ny & 0xf) << 4);
+        }
+    }
+}
+
+void mm_normal(const material_map_t *map, int x, int y, int *nx, int *ny) {
+    int col = x >> map->cell_shift;
+    int row = y >> map->cell_shift;
+    if (x < 0 || y < 0 || col >= map->cols || row >= map->rows) {
+        *nx = *ny = 0;
+        return;
+    }
+    unsigned char packed = map->normals[row * map->cols + col];
+    // sign-extend each 4-bit half
+    *nx = (packed & 0xf) - ((packed & 0x8) ? 16 : 0);
+    *ny = (packed >> 4) - ((packed & 0x80) ? 16 : 0);
+}
@@ -0,0 +1,122 @@
+/*
+ * Frame-stage profiler. Keeps a rolling window of samples per named
+ * stage and summarizes them on screen or over the UART.
+ * Compiled only when PROFILE is defined.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "prof.h"
+
+#ifdef PROFILE
+
+#include "gl_extra.h"
+#include "printf.h"
+#include "strings.h"
+#include "timer.h"
+
+typedef struct {
+    const char *name;
+    unsigned int samples[PROF_WINDOW];  // most recent durations, in usecs
+    int count;                          // samples recorded, capped at PROF_WINDOW
+    int next;                           // slot the next sample overwrites
+} stage_t;
+
+typedef struct {
+    unsigned int min;
+    unsigned int avg;
+    unsigned int max;
+    unsigned int p99;
+} summary_t;
+
+static stage_t stages[PROF_MAX_STAGES];
+static int num_stages = 0;
+static bool hud_enabled = false;
+
+static const int HUD_X = 4;
+static const int HUD_Y = 4;
+static const color_t HUD_BACKGROUND = 0xFF000000;
+static const color_t HUD_TEXT = 0xFFFFFFFF;
+
+prof_scope_t prof_begin(int *stage, const char *name) {
+    if (*stage < 0 && num_stages < PROF_MAX_STAGES) {
+        stages[num_stages].name = name;
+        *stage = num_stages++;
+    }
+    return (prof_scope_t){ *stage, timer_get_ticks() };
+}
+
+void prof_end(prof_scope_t *scope) {
+    if (scope->stage < 0) {
+        return; // ran out of stage slots
+    }
+    stage_t *s = &stages[scope->stage];
+    s->samples[s->next] = timer_get_ticks() - scope->start;
+    s->next = (s->next + 1) % PROF_WINDOW;
+    if (s->count < PROF_WINDOW) {
+        s->count++;
+    }
+}
+
+/* Summarize the window of one stage; p99 needs a sorted copy */
+static summary_t summarize(const stage_t *s) {
+    summary_t sum = { 0, 0, 0, 0 };
+    if (s->count == 0) {
+        return sum;
+    }
+    unsigned int sorted[PROF_WINDOW];
+    unsigned int total = 0;
+    for (int i = 0; i < s->count; i++) {
+        unsigned int v = s->samples[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) { // insertion sort, window is small
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+        total += v;
+    }
+    sum.min = sorted[0];
+    sum.max = sorted[s->count - 1];
+    sum.avg = total / s->count;
+    sum.p99 = sorted[(99 * s->count + 99) / 100 - 1]; // ceil(0.99 n)-th smallest
+    return sum;
+}
+
+void prof_set_hud(bool enabled) {
+    hud_enabled = enabled;
+}
+
+void prof_draw_hud(void) {
+    if (!hud_enabled || num_stages == 0) {
+        return;
+    }
+    char line[40];
+    int line_height = gl_get_char_height();
+    int width = 26 * gl_get_char_width();
+    int height = num_stages * line_height;
+    gl_draw_rect(HUD_X, HUD_Y, width, height, HUD_BACKGROUND);
+    for (int i = 0; i < num_stages; i++) {
+        summary_t sum = summarize(&stages[i]);
+        snprintf(line, sizeof(line), "%s %d/%d", stages[i].name, sum.avg, sum.p99);
+        gl_draw_string(HUD_X, HUD_Y + i * line_height, line, HUD_TEXT);
+    }
+    gl_dirty_add(HUD_X, HUD_Y, width, height);
+}
+
+void prof_dump(void) {
+    printf("Frame stages over the last %d samples (usecs):\n", PROF_WINDOW);
+    for (int i = 0; i < num_stages; i++) {
+        summary_t sum = summarize(&stages[i]);
+        printf("  %s: min %d avg %d max %d p99 %d (n=%d)\n", stages[i].name, sum.min, sum.avg, sum.max, sum.p99, stages[i].count);
+    }
+}
+
+void prof_reset(void) {
+    for (int i = 0; i < num_stages; i++) {
+        stages[i].count = 0;
+        stages[i].next = 0;
+    }
+}
+
+#endif
@@ -1,17 +1,39 @@
 #include "rand.h"
+#include "timer.h"
+
+/*
+ * Global streams, one per subsystem, jumped apart from a single seed so
+ * they never overlap (see rng.h). Seeded with a fixed value until
+ * rand_seed is called.
+ */
+static rng_t streams[RAND_NUM_STREAMS];
+static bool seeded = false;
+
+void rand_seed(unsigned int seed) {
+    rng_t root;
+    rng_seed(&root, seed);
+    for (int i = 0; i < RAND_NUM_STREAMS; i++) {
+        streams[i] = root;
+        rng_jump(&root);
+    }
+    seeded = true;
+}
+
+unsigned int rand_entropy(void) {
+    return timer_get_ticks();
+}
+
+rng_t *rand_stream(rand_stream_t stream) {
+    if (!seeded) {
+        rand_seed(12345);
+    }
+    return &streams[stream];
+}
 
-// From http://stackoverflow.com/questions/1167253/implementation-of-rand
 unsigned int rand(void) {
-    static unsigned int z1 = 12345, z2 = 12345, z3 = 12345, z4 = 12345;
-    unsigned int b;
+    return rng_next(rand_stream(RAND_LEVEL));
+}
 
-    b  = ((z1 << 6) ^ z1) >> 13;
-    z1 = ((z1 & 4294967294U) << 18) ^ b;
-    b  = ((z2 << 2) ^ z2) >> 27;
-    z2 = ((z2 & 4294967288U) << 2) ^ b;
-    b  = ((z3 << 13) ^ z3) >> 21;
-    z3 = ((z3 & 4294967280U) << 7) ^ b;
-    b  = ((z4 << 3) ^ z4) >> 12;
-    z4 = ((z4 & 4294967168U) << 13) ^ b;
-    return (z1 ^ z2 ^ z3 ^ z4);
+unsigned int rand_below(unsigned int bound) {
+    return rng_below(rand_stream(RAND_LEVEL), bound);
 }
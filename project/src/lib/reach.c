@@ -0,0 +1,118 @@
+/*
+ * Breadth-first reachability search over shots (see reach.h).
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "reach.h"
+#include "malloc.h"
+#include "strings.h"
+
+bool reach_init(reach_t *reach, const reach_problem_t *problem) {
+    const course_t *course = problem->course;
+    reach->cols = (course->width >> REACH_CELL_SHIFT) + 1;
+    reach->rows = (course->height >> REACH_CELL_SHIFT) + 1;
+    reach->queue_capacity = reach->cols * reach->rows;   // each cell is queued at most once
+    reach->visited = malloc(reach->queue_capacity);
+    reach->queue_x = malloc(reach->queue_capacity * sizeof(fix_t));
+    reach->queue_y = malloc(reach->queue_capacity * sizeof(fix_t));
+    reach->queue_shots = malloc(reach->queue_capacity);
+    bool ok = balls_init(&reach->batch, problem->angles * REACH_STRENGTHS);
+    return ok && reach->visited && reach->queue_x && reach->queue_y && reach->queue_shots;
+}
+
+void reach_free(reach_t *reach) {
+    balls_free(&reach->batch);
+    free(reach->visited);
+    free(reach->queue_x);
+    free(reach->queue_y);
+    free(reach->queue_shots);
+    reach->visited = reach->queue_shots = NULL;
+    reach->queue_x = reach->queue_y = NULL;
+}
+
+/* Mark the cell under (x, y) visited; false if it already was */
+static bool visit(reach_t *reach, fix_t x, fix_t y) {
+    int col = fix_round(x) >> REACH_CELL_SHIFT;
+    int row = fix_round(y) >> REACH_CELL_SHIFT;
+    col = col < 0 ? 0 : (col >= reach->cols ? reach->cols - 1 : col);
+    row = row < 0 ? 0 : (row >= reach->rows ? reach->rows - 1 : row);
+    unsigned char *cell = &reach->visited[row * reach->cols + col];
+    if (*cell) {
+        return false;
+    }
+    *cell = 1;
+    return true;
+}
+
+/*
+ * Launch every shot from (x, y) together and roll them until they stop.
+ * Returns false if the budget ran out first.
+ */
+static bool shoot_all(reach_t *reach, const reach_problem_t *problem, fix_t x, fix_t y) {
+    ball_batch_t *batch = &reach->batch;
+    int step_angle = FIX_ANGLE_STEPS / problem->angles;
+    balls_clear(batch);
+    for (int strength = 1; strength <= REACH_STRENGTHS; strength++) {
+        fix_t speed = problem->shot_speed * strength;
+        for (int a = 0; a < problem->angles; a++) {
+            int i = balls_add(batch, x, y);
+            balls_push_out(batch, i, problem->course);
+            balls_launch(batch, i, fix_mul(speed, fix_cos(a * step_angle)), fix_mul(speed, fix_sin(a * step_angle)));
+        }
+    }
+    for (int step = 0; step < problem->max_steps; step++) {
+        bool rolling = false;
+        for (int i = 0; i < batch->count; i++) {
+            rolling |= batch->state[i] == BALL_ROLLING;
+        }
+        if (!rolling) {
+            break;
+        }
+        if (reach->spent + batch->count > problem->budget) {
+            return false;
+        }
+        balls_step(batch, problem->course);
+        reach->spent += batch->count;
+    }
+    return true;
+}
+
+reach_result_t reach_check(reach_t *reach, const reach_problem_t *problem, int *shots) {
+    memset(reach->visited, 0, reach->cols * reach->rows);
+    reach->spent = 0;
+    int head = 0, tail = 0;
+    visit(reach, problem->tee_x, problem->tee_y);
+    reach->queue_x[tail] = problem->tee_x;
+    reach->queue_y[tail] = problem->tee_y;
+    reach->queue_shots[tail] = 0;
+    tail++;
+
+    while (head < tail) {
+        int taken = reach->queue_shots[head];
+        if (taken >= problem->max_shots) {
+            break;          // breadth-first, so every position left is as far
+        }
+        if (!shoot_all(reach, problem, reach->queue_x[head], reach->queue_y[head])) {
+            return REACH_UNKNOWN;
+        }
+        head++;
+
+        const ball_batch_t *batch = &reach->batch;
+        for (int i = 0; i < batch->count; i++) {
+            if (batch->state[i] == BALL_IN_HOLE) {
+                *shots = taken + 1;
+                return REACH_YES;
+            }
+        }
+        for (int i = 0; i < batch->count; i++) {
+            if (batch->state[i] != BALL_IN_WATER && visit(reach, batch->x[i], batch->y[i])) {
+                reach->queue_x[tail] = batch->x[i];
+                reach->queue_y[tail] = batch->y[i];
+                reach->queue_shots[tail] = taken + 1;
+                tail++;
+            }
+        }
+    }
+    return REACH_NO;
+}
@@ -0,0 +1,239 @@
+/*
+ * Input log recording and playback (see replay.h).
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "replay.h"
+#include "gpio.h"
+#include "keyboard.h"
+#include "mcp3008.h"
+#include "printf.h"
+#include "rand.h"
+#include "timer.h"
+
+/* Event tags live in the top 3 bits of an event's first byte */
+enum {
+    EV_FRAME = 0x00,
+    EV_GPIO = 0x20,       // bit 0: level read
+    EV_ADC = 0x40,        // bits 0-2: channel, bit 3: same as last reading
+    EV_TICKS = 0x60,
+    EV_KEY = 0x80,
+    EV_SEED = 0xa0,
+    EV_CHECK = 0xc0,
+};
+
+static const int TAG_MASK = 0xe0;
+static const int ADC_SAME = 0x08;
+#define ADC_CHANNELS 8
+
+static replay_mode_t mode = REPLAY_OFF;
+static unsigned char *record_buf;
+static const unsigned char *play_buf;
+static int length;                  // bytes in the log (playback) or its capacity (recording)
+static int cursor;                  // next byte to write or read
+static bool overflowed;
+static int mismatches;
+static unsigned int last_adc[ADC_CHANNELS];
+static unsigned int last_ticks;
+
+static void reset(void) {
+    cursor = 0;
+    overflowed = false;
+    mismatches = 0;
+    last_ticks = 0;
+    for (int ch = 0; ch < ADC_CHANNELS; ch++) {
+        last_adc[ch] = ~0u;   // no reading yet, so the first is never "same"
+    }
+}
+
+/* Append one event, or stop recording if it does not fit */
+static void emit(const unsigned char *bytes, int n) {
+    if (cursor + n > length) {
+        overflowed = true;
+        mode = REPLAY_OFF;
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        record_buf[cursor++] = bytes[i];
+    }
+}
+
+static void emit_word(int tag, unsigned int value) {
+    unsigned char bytes[] = { tag, value, value >> 8, value >> 16, value >> 24 };
+    emit(bytes, sizeof(bytes));
+}
+
+/* The desync is reported once; input is live from here on */
+static void desync(const char *what) {
+    printf("replay: log does not match at byte %d (%s), input is live\n", cursor, what);
+    mismatches++;
+    mode = REPLAY_OFF;
+}
+
+/*
+ * Consume the next event if its tag is `tag` and the n bytes it needs
+ * are there, returning its first byte; otherwise stop playback and
+ * return -1.
+ */
+static int take(int tag, int n, const char *what) {
+    if (cursor + n > length || (play_buf[cursor] & TAG_MASK) != tag) {
+        desync(what);
+        return -1;
+    }
+    int first = play_buf[cursor];
+    cursor++;
+    return first;
+}
+
+static unsigned int take_word(void) {
+    const unsigned char *p = &play_buf[cursor];
+    cursor += 4;
+    return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+void replay_record(unsigned char *buf, int capacity, unsigned int seed) {
+    reset();
+    record_buf = buf;
+    length = capacity;
+    mode = REPLAY_RECORDING;
+    rand_seed(seed);
+    emit_word(EV_SEED, seed);
+}
+
+void replay_play(const unsigned char *log, int log_length) {
+    reset();
+    play_buf = log;
+    length = log_length;
+    mode = REPLAY_PLAYING;
+    if (take(EV_SEED, 5, "seed") >= 0) {
+        rand_seed(take_word());
+    }
+}
+
+int replay_stop(void) {
+    mode = REPLAY_OFF;
+    return overflowed ? -1 : cursor;
+}
+
+replay_mode_t replay_mode(void) {
+    return mode;
+}
+
+int replay_mismatches(void) {
+    return mismatches;
+}
+
+void replay_frame(void) {
+    if (mode == REPLAY_RECORDING) {
+        unsigned char tag = EV_FRAME;
+        emit(&tag, 1);
+    }
+    else if (mode == REPLAY_PLAYING) {
+        take(EV_FRAME, 1, "frame");
+    }
+}
+
+void replay_check(int value) {
+    if (mode == REPLAY_RECORDING) {
+        emit_word(EV_CHECK, value);
+    }
+    else if (mode == REPLAY_PLAYING && take(EV_CHECK, 5, "check") >= 0) {
+        if ((int)take_word() != value) {
+            mismatches++;
+        }
+    }
+}
+
+unsigned int replay_mcp3008_read(unsigned int channel) {
+    channel %= ADC_CHANNELS;
+    if (mode == REPLAY_PLAYING) {
+        int first = take(EV_ADC, 1, "mcp3008_read");
+        if (first >= 0) {
+            if (!(first & ADC_SAME)) {
+                if (cursor + 2 > length) {
+                    desync("mcp3008_read");
+                    return mcp3008_read(channel);
+                }
+                last_adc[channel] = play_buf[cursor] | play_buf[cursor + 1] << 8;
+                cursor += 2;
+            }
+            return last_adc[channel];
+        }
+    }
+    unsigned int value = mcp3008_read(channel);
+    if (mode == REPLAY_RECORDING) {
+        if (value == last_adc[channel]) {
+            unsigned char tag = EV_ADC | ADC_SAME | channel;
+            emit(&tag, 1);
+        }
+        else {
+            unsigned char bytes[] = { EV_ADC | channel, value, value >> 8 };
+            emit(bytes, sizeof(bytes));
+        }
+        last_adc[channel] = value;
+    }
+    return value;
+}
+
+unsigned int replay_gpio_read(unsigned int pin) {
+    if (mode == REPLAY_PLAYING) {
+        int first = take(EV_GPIO, 1, "gpio_read");
+        if (first >= 0) {
+            return first & 1;
+        }
+    }
+    unsigned int value = gpio_read(pin);
+    if (mode == REPLAY_RECORDING) {
+        unsigned char tag = EV_GPIO | (value & 1);
+        emit(&tag, 1);
+    }
+    return value;
+}
+
+unsigned char replay_keyboard_read_next(void) {
+    if (mode == REPLAY_PLAYING && take(EV_KEY, 2, "keyboard_read_next") >= 0) {
+        return play_buf[cursor++];
+    }
+    unsigned char ch = keyboard_read_next();
+    if (mode == REPLAY_RECORDING) {
+        unsigned char bytes[] = { EV_KEY, ch };
+        emit(bytes, sizeof(bytes));
+    }
+    return ch;
+}
+
+unsigned int replay_timer_get_ticks(void) {
+    if (mode == REPLAY_PLAYING && take(EV_TICKS, 1, "timer_get_ticks") >= 0) {
+        unsigned int delta = 0;
+        for (int shift = 0; shift < 35 && cursor < length; shift += 7) {
+            unsigned char byte = play_buf[cursor++];
+            delta |= (unsigned int)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        last_ticks += delta;
+        return last_ticks;
+    }
+    unsigned int now = timer_get_ticks();
+    if (mode == REPLAY_RECORDING) {
+        unsigned char bytes[6] = { EV_TICKS };
+        int n = 1;
+        unsigned int delta = now - last_ticks;   // the first delta is the whole tick count
+        do {
+            bytes[n] = (delta & 0x7f) | (delta > 0x7f ? 0x80 : 0);
+            delta >>= 7;
+            n++;
+        } while (delta != 0);
+        emit(bytes, n);
+        last_ticks = now;
+    }
+    return now;
+}
+
+void replay_timer_delay(unsigned int secs) {
+    if (mode != REPLAY_PLAYING) {
+        timer_delay(secs);
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * xoshiro128** by David Blackman and Sebastiano Vigna, seeded through
+ * splitmix32 (see rng.h).
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "rng.h"
+
+static unsigned int splitmix32(unsigned int *x) {
+    unsigned int z = (*x += 0x9e3779b9);
+    z = (z ^ (z >> 16)) * 0x85ebca6b;
+    z = (z ^ (z >> 13)) * 0xc2b2ae35;
+    return z ^ (z >> 16);
+}
+
+void rng_seed(rng_t *rng, unsigned int seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix32(&seed);
+    }
+    if ((rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3]) == 0) {
+        rng->s[0] = 1;   // the all-zero state would only ever produce zeros
+    }
+}
+
+void rng_jump(rng_t *rng) {
+    static const unsigned int JUMP[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+    unsigned int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 32; b++) {
+            if (JUMP[i] & (1u << b)) {
+                s0 ^= rng->s[0];
+                s1 ^= rng->s[1];
+                s2 ^= rng->s[2];
+                s3 ^= rng->s[3];
+            }
+            rng_next(rng);
+        }
+    }
+    rng->s[0] = s0;
+    rng->s[1] = s1;
+    rng->s[2] = s2;
+    rng->s[3] = s3;
+}
+
+unsigned int rng_below(rng_t *rng, unsigned int bound) {
+    unsigned long long m = (unsigned long long)rng_next(rng) * bound;
+    unsigned int low = (unsigned int)m;
+    if (low < bound) {
+        // only products whose low word falls under 2^32 mod bound are biased
+        unsigned int threshold = -bound % bound;
+        while (low < threshold) {
+            m = (unsigned long long)rng_next(rng) * bound;
+            low = (unsigned int)m;
+        }
+    }
+    return (unsigned int)(m >> 32);
+}
+
+void rng_fill(rng_t *rng, unsigned int out[], int n) {
+    rng_t local = *rng;
+    for (int i = 0; i < n; i++) {
+        out[i] = rng_next(&local);
+    }
+    *rng = local;
+}
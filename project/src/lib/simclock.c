@@ -0,0 +1,37 @@
+/*
+ * Fixed-timestep accumulator on the free-running microsecond timer.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "simclock.h"
+#include "replay.h"
+
+void sim_clock_init(sim_clock_t *clock, unsigned int step_us, int max_steps) {
+    clock->step_us = step_us;
+    clock->max_steps = max_steps;
+    sim_clock_reset(clock);
+}
+
+void sim_clock_reset(sim_clock_t *clock) {
+    clock->last_ticks = replay_timer_get_ticks();
+    clock->accumulator = 0;
+}
+
+int sim_clock_advance(sim_clock_t *clock) {
+    unsigned int now = replay_timer_get_ticks();
+    clock->accumulator += now - clock->last_ticks;   // unsigned, so wraparound is harmless
+    clock->last_ticks = now;
+
+    int steps = clock->accumulator / clock->step_us;
+    if (steps > clock->max_steps) {
+        steps = clock->max_steps;
+        clock->accumulator = clock->max_steps * clock->step_us;
+    }
+    clock->accumulator -= steps * clock->step_us;
+    return steps;
+}
+
+fix_t sim_clock_alpha(const sim_clock_t *clock) {
+    return (fix_t)(((long long)clock->accumulator << FIX_SHIFT) / clock->step_us);
+}
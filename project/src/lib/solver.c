@@ -0,0 +1,108 @@
+/*
+ * Shot solver: simulates candidate shots in batches on the ball engine
+ * and scores where they stop.
+ *
+ * Boxin Zhang, Yiyang (Young) Chen
+ */
+
+#include "solver.h"
+
+static const int MAX_ANGLE_JITTER = 2;      // rotor steps either way
+static const int MAX_SPEED_JITTER = 1024;   // of 65536, i.e. about 1.5% either way
+
+bool solver_worker_init(solver_worker_t *worker, const solver_problem_t *problem, int chunk) {
+    bool ok = balls_init(&worker->batch, chunk * (1 + problem->perturbations));
+    worker->chunk = ok ? chunk : 0;
+    return ok;
+}
+
+void solver_worker_free(solver_worker_t *worker) {
+    balls_free(&worker->batch);
+    worker->chunk = 0;
+}
+
+/* Well-mixed 32-bit hash, so every (seed, candidate, variant) gets its own dice */
+static unsigned int hash(unsigned int x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+/* Uniform in -range .. range */
+static int jitter(unsigned int bits, int range) {
+    return (int)(bits % (2 * range + 1)) - range;
+}
+
+/* Velocity of a variant of a candidate; variant 0 is the shot itself */
+static void shot_velocity(const solver_problem_t *problem, int candidate, int variant, fix_t *vx, fix_t *vy) {
+    int angle = solver_angle(candidate);
+    fix_t speed = problem->shot_speed * solver_strength(candidate);
+    if (variant > 0) {
+        unsigned int bits = hash(problem->seed ^ hash(candidate * 64 + variant));
+        angle += jitter(bits & 0xffff, MAX_ANGLE_JITTER);
+        speed += fix_mul(speed, jitter(bits >> 16, MAX_SPEED_JITTER));
+    }
+    *vx = fix_mul(speed, fix_cos(angle));
+    *vy = fix_mul(speed, fix_sin(angle));
+}
+
+/* Score of ball i where it stopped */
+static int score_ball(const solver_problem_t *problem, const ball_batch_t *batch, int i) {
+    if (batch->state[i] == BALL_IN_HOLE) {
+        return 0;
+    }
+    if (batch->state[i] == BALL_IN_WATER) {
+        return SOLVER_WATER_PENALTY;
+    }
+    int dx = fix_round(batch->x[i]) - (problem->goal.x + problem->goal.width / 2);
+    int dy = fix_round(batch->y[i]) - (problem->goal.y + problem->goal.height / 2);
+    return fix_isqrt((long long)dx * dx + (long long)dy * dy);
+}
+
+void solver_eval(const solver_problem_t *problem, solver_worker_t *worker, int first, int count, int scores[]) {
+    ball_batch_t *batch = &worker->batch;
+    int variants = 1 + problem->perturbations;
+    balls_clear(batch);
+    for (int c = first; c < first + count; c++) {
+        for (int v = 0; v < variants; v++) {
+            int i = balls_add(batch, problem->tee_x, problem->tee_y);
+            fix_t vx, vy;
+            shot_velocity(problem, c, v, &vx, &vy);
+            balls_push_out(batch, i, problem->course);   // once: the sweep keeps balls out of walls from here
+            balls_launch(batch, i, vx, vy);
+        }
+    }
+
+    // the whole chunk rolls together until every ball has stopped
+    for (int step = 0; step < problem->max_steps; step++) {
+        bool rolling = false;
+        for (int i = 0; i < batch->count; i++) {
+            rolling |= batch->state[i] == BALL_ROLLING;
+        }
+        if (!rolling) {
+            break;
+        }
+        balls_step(batch, problem->course);
+    }
+
+    for (int k = 0; k < count; k++) {
+        int total = 0;
+        for (int v = 0; v < variants; v++) {
+            total += score_ball(problem, batch, k * variants + v);
+        }
+        scores[first + k] = total;
+    }
+}
+
+int solver_best(const int scores[], int count) {
+    int best = 0;
+    for (int c = 1; c < count; c++) {
+        if (scores[c] < scores[best]) {
+            best = c;
+        }
+    }
+    return best;
+}
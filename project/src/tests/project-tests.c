@@ -2,8 +2,11 @@
 #include "printf.h"
 #include "strings.h"
 #include "gl.h"
+#include "gl_extra.h"
 #include "bullet.h"
+#include "fixed.h"
 #include "golf.h"
+#include "levelgen.h"
 #include "font.h"
 #include "uart.h"
 #include "timer.h"
@@ -17,10 +20,15 @@
 #include "shell_commands.h"
 #include "ps2.h"
 #include "keyboard.h"
+#include "prof.h"
+#include "simclock.h"
+#include "replay.h"
+#include "rand.h"
 
 #define AIM_ROTOR 3
 #define MOVE_ROTOR 4
 static const int BUTTON = GPIO_PIN20;
+static const int HINT_BUTTON = GPIO_PIN21;   // hold while aiming to show the best shot
 static int HEIGHT = 512;
 static int WIDTH = 640;
 static int num_index = 0;
@@ -30,6 +38,19 @@ static int total_shots = 5;
 static int MAX_OUTPUT_LEN = 100;
 int parity = 0;
 int parity_delay = 0;
+
+/* Physics runs at a fixed 60 steps per second, however long frames take */
+static const unsigned int SIM_STEP_US = 1000000 / 60;
+static const int SIM_MAX_STEPS = 6;      // catch-up limit after a stall
+static const int PARITY_STEPS = 4;       // physics steps between animation flips
+static const bool INTERPOLATE = true;    // draw the ball between physics steps
+static sim_clock_t sim_clock;
+
+/* Time given to the shot search in each aiming frame */
+static const unsigned int HINT_BUDGET_US = 4000;
+
+/* Room for about half an hour of play at a few bytes per frame */
+static const int REPLAY_LOG_BYTES = 1 << 20;
 char *leaderboard_names[5];
 int leaderboard_scores[5];
 
@@ -57,18 +78,26 @@ void get_user_input_stage(void) {
     }
 }
 
+/* Whether to draw the screens between shots: not while replaying */
+static bool rendering(void) {
+    return replay_mode() != REPLAY_PLAYING;
+}
+
 void get_golf_input_stage(void) {
     char str_buffer[MAX_OUTPUT_LEN];
     memset(str_buffer, '\0', MAX_OUTPUT_LEN);
 
-    gl_clear(0xE36B89);
-    snprintf(str_buffer, MAX_OUTPUT_LEN, "You have %d shots left this round", total_shots);
-    gl_draw_string(100, HEIGHT / 2 - 20, str_buffer, GL_GREEN);
-    gl_swap_buffer();
-    timer_delay(2);  
+    if (rendering()) {
+        gl_clear(0xE36B89);
+        snprintf(str_buffer, MAX_OUTPUT_LEN, "You have %d shots left this round", total_shots);
+        gl_draw_string(100, HEIGHT / 2 - 20, str_buffer, GL_GREEN);
+        gl_swap_buffer();
+    }
+    replay_timer_delay(2);  
 
-    while (gpio_read(BUTTON) == 1) {
-        if(parity_delay == 2) {
+    while (replay_gpio_read(BUTTON) == 1) {
+        replay_frame();
+        if(parity_delay >= 2) {
             parity_delay = 0;
             flip_parity();
         }
@@ -77,25 +106,199 @@ void get_golf_input_stage(void) {
         }
         draw_field(parity); // Draw field
         get_angle();
+        bool want_hint = replay_gpio_read(HINT_BUTTON) == 0;
+        if (rendering()) {
+            hint_update(HINT_BUDGET_US);
+            if (want_hint) {
+                draw_hint();
+            }
+        }
         draw_ball();     // Draw the ball
     }
 
     total_shots--;
+    sim_clock_reset(&sim_clock);  // the shot starts now, not when aiming began
+}
+
+/* Whether the ball came to rest, fell in a lake or reached the goal */
+bool shot_over(void) {
+    return hit_lake() || ball_at_rest() || hit_goal();
 }
 
+/*
+ * Run the physics steps that are due since the last frame, stopping as
+ * soon as the shot is over, then draw the field and the ball.
+ */
 void frame(void) {
-    if(parity_delay == 2) {
+    PROF_SCOPE("frame");
+    replay_frame();
+    int steps = sim_clock_advance(&sim_clock);
+    bool over = false;
+    {
+        PROF_SCOPE("physics");
+        for (int i = 0; i < steps && !over; i++) {
+            step_ball();
+            over = shot_over();
+        }
+    }
+
+    parity_delay += steps;
+    if (parity_delay >= PARITY_STEPS) {
         parity_delay = 0;
         flip_parity();
     }
-    else {
-        parity_delay++;
+
+    {
+        PROF_SCOPE("draw_field");
+        draw_field(parity);
+    }
+    {
+        PROF_SCOPE("draw_ball");
+        draw_ball_at(INTERPOLATE && !over ? sim_clock_alpha(&sim_clock) : FIX_ONE);
     }
+}
+
+/*
+ * The computer plays: it searches for its shot a frame at a time while
+ * the field keeps animating, then takes it. A new level follows every
+ * hole, from the library or generated as in play_game, and a ball in
+ * the water goes back to the level's tee; shots are counted on the
+ * terminal.
+ */
+void test_golf_ai(void) {
+    gl_init(640, 512, GL_TRIPLEBUFFER);
+    sim_clock_init(&sim_clock, SIM_STEP_US, SIM_MAX_STEPS);
+    golf_next_level();
+    int shots = 0;
 
-    draw_field(parity);
-    draw_ball();
-    hit_wall();
-    move_ball();
+    while (1) {
+        unsigned int start = timer_get_ticks();
+        while (!hint_update(HINT_BUDGET_US)) {
+            draw_field(parity);
+            draw_hint();
+            draw_ball();
+        }
+        printf("Shot %d found in %d ms\n", shots + 1, (timer_get_ticks() - start) / 1000);
+        take_best_shot();
+        shots++;
+        sim_clock_reset(&sim_clock);
+        do {
+            frame();
+        } while (!shot_over());
+
+        if (hit_lake()) {
+            ball_tee();
+        } else if (hit_goal()) {
+            printf("Holed in %d shot(s), par %d\n", shots, level_par());
+            shots = 0;
+            golf_next_level();
+        }
+    }
+}
+
+/*
+ * The computer plays through the curated levels linked into the image
+ * (see level.h), reporting its shots against each level's par. A level
+ * it cannot load, or cannot hole in PACK_MAX_SHOTS, counts as a failure.
+ */
+static const int PACK_MAX_SHOTS = 15;          // three times what a player gets
+static const int PACK_SEARCH_FRAMES = 5120;    // each hint_update tries a shot or more, so a longer search is stuck
+
+void test_golf_pack(void) {
+    gl_init(640, 512, GL_TRIPLEBUFFER);
+    sim_clock_init(&sim_clock, SIM_STEP_US, SIM_MAX_STEPS);
+    int number = 1;
+    int failures = 0;
+
+    for (const level_t *level = level_first(__levels_start__, __levels_end__); level != NULL;
+         level = level_next(level, __levels_end__), number++) {
+        unsigned int start = timer_get_ticks();
+        if (!golf_load_level(level, __levels_end__ - (const char *)level)) {
+            printf("Level %d failed to load\n", number);
+            failures++;
+            continue;
+        }
+        printf("Level %d loaded in %d usecs\n", number, timer_get_ticks() - start);
+        int shots = 0;
+        bool holed = false;
+        while (!holed && shots < PACK_MAX_SHOTS) {
+            for (int frames = 0; !hint_update(HINT_BUDGET_US) && frames < PACK_SEARCH_FRAMES; frames++) {
+                draw_field(parity);
+                draw_hint();
+                draw_ball();
+            }
+            if (!take_best_shot()) {
+                break;   // the search never finished, e.g. out of memory
+            }
+            shots++;
+            sim_clock_reset(&sim_clock);
+            do {
+                frame();
+            } while (!shot_over());
+            if (hit_lake()) {
+                ball_tee();
+            }
+            holed = hit_goal();
+        }
+        if (holed) {
+            printf("Level %d holed in %d shot(s), par %d\n", number, shots, level_par());
+        } else {
+            printf("Level %d FAILED: not holed after %d shot(s), par %d\n", number, shots, level_par());
+            failures++;
+        }
+    }
+    printf("%d level(s) played, %d failure(s)\n", number - 1, failures);
+}
+
+/*
+ * Measures on the Pi what LEVELGEN_REACH_BUDGET (levelgen.h) assumes:
+ * how many ball steps balls_step runs a millisecond, and how long the
+ * slowest of a run of generated levels takes.
+ */
+void test_levelgen_budget(void) {
+    static uint32_t record[LEVEL_BYTES(LEVEL_MAX_SHAPES) / 4];
+    static levelgen_t gen;
+    static level_course_t field;
+    level_t *level = (level_t *)record;
+    unsigned int worst = 0, total = 0;
+    int levels = 64, open = 0;
+    for (int i = 0; i < levels; i++) {
+        unsigned int start = timer_get_ticks();
+        levelgen_make(&gen, level, i + 1, &field);
+        unsigned int elapsed = timer_get_ticks() - start;
+        total += elapsed;
+        worst = elapsed > worst ? elapsed : worst;
+        open += level->par < 0;
+    }
+    printf("%d levels: %d usecs each, %d at worst (budget %d), %d without a par\n",
+           levels, total / levels, worst, LEVELGEN_BUDGET_US, open);
+
+    // every shot from the last level's tee, as the reach check takes them
+    ball_batch_t batch = { 0 };
+    assert(balls_init(&batch, 32 * 5));
+    for (int strength = 1; strength <= 5; strength++) {
+        for (int a = 0; a < 32; a++) {
+            int i = balls_add(&batch, fix_from_int(level->tee_x), fix_from_int(level->tee_y));
+            balls_push_out(&batch, i, &field.course);
+            fix_t speed = LEVELGEN_SHOT_SPEED * strength;
+            int angle = a * FIX_ANGLE_STEPS / 32;
+            balls_launch(&batch, i, fix_mul(speed, fix_cos(angle)), fix_mul(speed, fix_sin(angle)));
+        }
+    }
+    int steps = 0;
+    unsigned int start = timer_get_ticks();
+    for (bool rolling = true; rolling && steps < 300 * batch.count; ) {
+        balls_step(&batch, &field.course);
+        steps += batch.count;
+        rolling = false;
+        for (int i = 0; i < batch.count; i++) {
+            rolling |= batch.state[i] == BALL_ROLLING;
+        }
+    }
+    unsigned int elapsed = timer_get_ticks() - start;
+    printf("%d ball steps in %d usecs: %d a ms (LEVELGEN_PI_STEPS_PER_MS is %d)\n",
+           steps, elapsed, (int)((long long)steps * 1000 / elapsed), LEVELGEN_PI_STEPS_PER_MS);
+    balls_free(&batch);
 }
 
 void test_bullet(void){
@@ -182,6 +385,61 @@ void test_potentiometer(void) {
     }
 }
 
+/* Old gl_draw_rect: one bounds-checked gl_draw_pixel per pixel */
+static void draw_rect_per_pixel(int x, int y, int w, int h, color_t c) {
+    for (int y_len = y; y_len < y + h; y_len++) {
+        for (int x_len = x; x_len < x + w; x_len++) {
+            gl_draw_pixel(x_len, y_len, c);
+        }
+    }
+}
+
+/* Print fill rate as megapixels/second with two decimals */
+static void report_fill_rate(const char *label, unsigned int pixels, unsigned int usecs) {
+    if (usecs == 0) {
+        usecs = 1;
+    }
+    unsigned int rate = (unsigned int)((unsigned long long)pixels * 100 / usecs); // Mpix/s * 100
+    printf("%s: %d pixels in %d usecs = %d.%02d Mpix/s\n", label, pixels, usecs, rate / 100, rate % 100);
+}
+
+void test_fill_benchmark(void) {
+    gl_init(640, 512, GL_DOUBLEBUFFER);
+    const int reps = 10;
+    const int small_reps = 5000;
+    unsigned int start;
+
+    start = timer_get_ticks();
+    for (int i = 0; i < reps; i++) {
+        draw_rect_per_pixel(0, 0, WIDTH, HEIGHT, GL_BLUE);
+    }
+    report_fill_rate("full screen, per pixel", reps * WIDTH * HEIGHT, timer_get_ticks() - start);
+
+    start = timer_get_ticks();
+    for (int i = 0; i < reps; i++) {
+        gl_draw_rect(0, 0, WIDTH, HEIGHT, GL_BLUE);
+    }
+    report_fill_rate("full screen, spans    ", reps * WIDTH * HEIGHT, timer_get_ticks() - start);
+
+    start = timer_get_ticks();
+    for (int i = 0; i < reps; i++) {
+        gl_clear(GL_BLUE);
+    }
+    report_fill_rate("full screen, gl_clear ", reps * WIDTH * HEIGHT, timer_get_ticks() - start);
+
+    start = timer_get_ticks();
+    for (int i = 0; i < small_reps; i++) {
+        draw_rect_per_pixel(i % 600, i % 500, 11, 11, GL_WHITE);
+    }
+    report_fill_rate("11x11 rect, per pixel ", small_reps * 11 * 11, timer_get_ticks() - start);
+
+    start = timer_get_ticks();
+    for (int i = 0; i < small_reps; i++) {
+        gl_draw_rect(i % 600, i % 500, 11, 11, GL_WHITE);
+    }
+    report_fill_rate("11x11 rect, spans     ", small_reps * 11 * 11, timer_get_ticks() - start);
+}
+
 void test_field_init(void){
     gl_init(640, 512, GL_DOUBLEBUFFER);
     lake_init();
@@ -209,21 +467,85 @@ void test_golf_readings(void) {
     }
 }
 
+/* Log where the ball stopped, or compare it with the log when replaying */
+static void check_ball(void) {
+    fix_t x, y;
+    get_ball_position(&x, &y);
+    replay_check(x);
+    replay_check(y);
+}
+
+/* Play shots, moving on to a new level after each hole, until they run out */
+void play_game(void) {
+    char str_buffer[MAX_OUTPUT_LEN];
+    memset(str_buffer, '\0', MAX_OUTPUT_LEN);
+    bool playing = true;
+
+    while (playing) { //restarts new golf hits
+        get_golf_input_stage();
+
+        while (playing) { //post-shooting stage
+            frame();
+            if (shot_over()) {
+                check_ball();
+            }
+
+            if(total_shots < 0) {
+                playing = false;
+                break;
+            }
+            if (hit_lake()){
+                ball_tee();
+                break;
+            }
+            if(ball_at_rest()) {
+                break;
+            }
+            if (hit_goal()){
+                points++;
+                // if(points > high_score) {
+                //     high_score = points;
+                // }
+                total_shots = 5;
+
+                //drawing tracker screen
+                if (rendering()) {
+                    gl_clear(0xE36B89);
+                    snprintf(str_buffer, MAX_OUTPUT_LEN, "Yay! You have %d point(s) :D", points);
+                    gl_draw_string(150, HEIGHT / 2, str_buffer, GL_GREEN);
+                    gl_swap_buffer();
+                }
+                replay_timer_delay(5);
+
+                // printf("Success! Now you have %d points\n", points); // print out success when hit target
+                golf_next_level();
+                break;
+            }
+        }
+    }
+}
+
+/* Start a fresh game of five shots on a new level */
+static void new_game(void) {
+    points = 0;
+    total_shots = 5;
+    golf_next_level();
+}
+
 void test_golf(void) {
     gpio_init();
     uart_init();
     mcp3008_init();
     keyboard_init(KEYBOARD_CLOCK, KEYBOARD_DATA);
-    shell_init(keyboard_read_next, printf);
+    shell_init(replay_keyboard_read_next, printf);
 
     bool stop_game_bit = 1;
 
-    gl_init(640, 512, GL_DOUBLEBUFFER);
+    gl_init(640, 512, GL_TRIPLEBUFFER);
+    prof_set_hud(true);   // no-op unless built with PROFILE=1
+    sim_clock_init(&sim_clock, SIM_STEP_US, SIM_MAX_STEPS);
     init_leaderboard();
-    ball_init(5, 0);
-    lake_init();
-    wall_init();
-    goal_init();         // Using randomized algorithm
+    golf_next_level();
 
     //drawing tracker screen
     gl_clear(0xE36B89);
@@ -232,9 +554,6 @@ void test_golf(void) {
     gl_swap_buffer();
     timer_delay(5);
 
-    char str_buffer[MAX_OUTPUT_LEN];
-    memset(str_buffer, '\0', MAX_OUTPUT_LEN);
-
     while (stop_game_bit) {
 
         printf("\nTYPE YOUR NAME HERE: \n");
@@ -244,47 +563,14 @@ void test_golf(void) {
         shell_readline(line, sizeof(line));
         memset(line_ptr, '\0', 30);
         memcpy(line_ptr, line, strlen(line));
-    
-        while (stop_game_bit) { //restarts new golf hits
-            get_golf_input_stage();
 
-            while (stop_game_bit) { //post-shooting stage
-                frame();
+        // however long the name took to type decides this game's levels
+        rand_seed(rand_entropy());
+        new_game();
+    
+        play_game();
 
-                if(total_shots < 0) {
-                    stop_game_bit = 0;
-                    break;
-                }
-                if (hit_lake()){
-                    ball_init(5, 0);
-                    break;
-                }
-                if(get_ball_xvel() == 0 && get_ball_yvel() ==0) {
-                    break;
-                }
-                if (hit_goal()){
-                    points++;
-                    // if(points > high_score) {
-                    //     high_score = points;
-                    // }
-                    total_shots = 5;
-
-                    //drawing tracker screen
-                    gl_clear(0xE36B89);
-                    snprintf(str_buffer, MAX_OUTPUT_LEN, "Yay! You have %d point(s) :D", points);
-                    gl_draw_string(150, HEIGHT / 2, str_buffer, GL_GREEN);
-                    gl_swap_buffer();
-                    timer_delay(5);
-
-                    // printf("Success! Now you have %d points\n", points); // print out success when hit target
-                    ball_init(5, 0);
-                    lake_init();
-                    wall_init();
-                    goal_init();
-                    break;
-                }
-            }
-        }
+        prof_dump();  // frame timings for the game just played
 
         //storing to leaderboards if applicable
         leaderboard_names[num_index] = line_ptr;
@@ -310,10 +596,7 @@ void test_golf(void) {
         total_shots = 5;
 
         //drawing tracker screen
-        ball_init(5, 0);
-        lake_init();
-        wall_init();
-        goal_init();         // Using randomized algorithm
+        golf_next_level();
 
         gl_clear(0xE36B89);
         gl_draw_string(180, HEIGHT / 2 - 20, "Ready, Set, Go!", GL_GREEN);
@@ -323,6 +606,45 @@ void test_golf(void) {
     }
 }
 
+/*
+ * Record one game with the inputs logged, then replay the log with
+ * drawing off and check that every shot stops where it did live.
+ */
+void test_golf_replay(void) {
+    gpio_init();
+    uart_init();
+    mcp3008_init();
+
+    gl_init(640, 512, GL_TRIPLEBUFFER);
+    sim_clock_init(&sim_clock, SIM_STEP_US, SIM_MAX_STEPS);
+    unsigned char *log = malloc(REPLAY_LOG_BYTES);
+    assert(log != NULL);
+
+    replay_record(log, REPLAY_LOG_BYTES, timer_get_ticks());
+    new_game();
+    play_game();
+    int length = replay_stop();
+    int live_points = points;
+    if (length < 0) {
+        printf("Game did not fit in the %d byte log\n", REPLAY_LOG_BYTES);
+        free(log);
+        return;
+    }
+    printf("Recorded %d points in %d bytes\n", live_points, length);
+
+    golf_set_headless(true);
+    replay_play(log, length);
+    unsigned int start = timer_get_ticks();
+    new_game();
+    play_game();
+    unsigned int elapsed = timer_get_ticks() - start;
+    replay_stop();
+    golf_set_headless(false);
+    int mismatches = replay_mismatches() + (points != live_points);
+    printf("Replayed %d points (%d live) in %d usecs, %d mismatches\n", points, live_points, elapsed, mismatches);
+    free(log);
+}
+
 void main(void){
     gpio_init();
     uart_init();    
@@ -331,10 +653,17 @@ void main(void){
 
     gpio_set_input(BUTTON); // configure button
     gpio_set_pullup(BUTTON);
+    gpio_set_input(HINT_BUTTON);
+    gpio_set_pullup(HINT_BUTTON);
     
     // test_table_init();
+    // test_fill_benchmark();
     // test_golf_readings();
     test_golf();
+    // test_golf_ai();
+    // test_golf_replay();
+    // test_golf_pack();
+    // test_levelgen_budget();
 
     // test_bullet();
     // test_hole_init();